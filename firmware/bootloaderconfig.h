@@ -264,7 +264,9 @@ these macros are defined, the boot loader usees them.
 #else
 #       define EXIT_AFTER_UPLOAD           0
 #endif
-/* Exit bootloader after program upload
+/* Exit bootloader after program upload: as soon as the USBASP_FUNC_DISCONNECT
+ * transfer is complete on the bus (see exitDue() in main.c) and pending
+ * flash and EEPROM writes are done.
  */
 
 #ifndef CONFIG_NO__CHIP_ERASE
@@ -288,6 +290,284 @@ these macros are defined, the boot loader usees them.
  * This feature may prevent this...
  */
 
+#ifdef CONFIG_USE__PAGE_PIPELINE
+#	define USE_PAGE_PIPELINE		1
+#else
+#	define USE_PAGE_PIPELINE		0
+#endif
+/* If USE_PAGE_PIPELINE is defined to 1, flash data is collected in a RAM page
+ * buffer instead of being filled into the SPM page buffer directly. Complete
+ * pages are erased and written from the main loop while USB already receives
+ * the data of the next page (the boot loader itself runs from NRWW flash).
+ * The host only gets NAKed (via USB_CFG_HAVE_FLOWCONTROL) if the next page
+ * is complete before the previous one has been programmed.
+ * Costs SPM_PAGESIZE bytes of RAM and some bytes of flash.
+ */
+
+#ifdef CONFIG_USE__PAGE_COMPARE
+#	define USE_PAGE_COMPARE		1
+#else
+#	define USE_PAGE_COMPARE		0
+#endif
+/* If USE_PAGE_COMPARE is defined to 1, flash data is collected in a RAM page
+ * buffer (like with USE_PAGE_PIPELINE) and every complete page is compared
+ * with the current flash contents first. Pages which are already identical
+ * are neither erased nor written, so reflashing an image with only a few
+ * changed pages gets much faster and saves flash endurance.
+ * Costs SPM_PAGESIZE bytes of RAM and some bytes of flash.
+ */
+
+#ifdef CONFIG_USE__PAGE_ERASE_ELISION
+#	define USE_PAGE_ERASE_ELISION	1
+#else
+#	define USE_PAGE_ERASE_ELISION	0
+#endif
+/* If USE_PAGE_ERASE_ELISION is defined to 1, flash data is collected in a RAM
+ * page buffer and every complete page is checked against flash before it is
+ * programmed: if the new data only clears bits (for example a table which is
+ * appended in place), the page is written without erasing it first. This
+ * saves one erase time per page and one erase cycle of endurance.
+ * Only has an effect if pages are erased on demand (HAVE_ONDEMAND_PAGEERASE
+ * or no HAVE_CHIP_ERASE).
+ * Costs SPM_PAGESIZE bytes of RAM and some bytes of flash.
+ */
+
+#ifdef CONFIG_USE__ERASED_PAGEMAP
+#  if   HAVE_CHIP_ERASE
+#       define USE_ERASED_PAGEMAP          1
+#  else
+#       define USE_ERASED_PAGEMAP          0
+#  endif
+#else
+#       define USE_ERASED_PAGEMAP          0
+#endif
+/* If USE_ERASED_PAGEMAP is defined to 1, the Chip Erase ISP command marks all
+ * pages as blank in a RAM bitmap (one bit per page). Flash data is collected
+ * in a RAM page buffer; a page known to be blank is written without erasing
+ * it first and is dropped completely if all its data is 0xff. This speeds up
+ * sparse images a lot. Requires HAVE_CHIP_ERASE.
+ * Costs SPM_PAGESIZE + (number of pages / 8) bytes of RAM and some bytes of
+ * flash.
+ */
+
+#ifdef CONFIG_USE__BACKGROUND_CHIPERASE
+#  if   HAVE_CHIP_ERASE
+#       define USE_BACKGROUND_CHIPERASE    1
+#  else
+#       define USE_BACKGROUND_CHIPERASE    0
+#  endif
+#else
+#       define USE_BACKGROUND_CHIPERASE    0
+#endif
+/* If USE_BACKGROUND_CHIPERASE is defined to 1, the Chip Erase ISP command only
+ * starts the erase and returns at once. The pages are erased one by one from
+ * the main loop, so USB keeps being serviced (a synchronous chip erase of an
+ * ATmega2560 takes several seconds). The host may poll the ISP RDY/BSY
+ * command (0xf0) until the erase is done; flash data sent meanwhile is
+ * programmed as soon as the erase has passed its page. Other ISP commands
+ * which do not access memory (e.g. program enable) are not delayed either.
+ * Requires HAVE_CHIP_ERASE. Uses the RAM page buffer (SPM_PAGESIZE bytes).
+ */
+
+#ifdef CONFIG_USE__WRITE_VERIFY
+#	define USE_WRITE_VERIFY		1
+#else
+#	define USE_WRITE_VERIFY		0
+#endif
+/* If USE_WRITE_VERIFY is defined to 1, flash data is collected in a RAM page
+ * buffer and every page is read back and checked (by CRC16) right after it
+ * has been written. The number of failed pages and the address of the first
+ * one since the last USBASP_FUNC_CONNECT can be read with the vendor request
+ * USBASP_FUNC_GETVERIFYSTATUS (64, 6 bytes reply: address as 32 bit and count
+ * as 16 bit value, little endian). A host trusting it may skip reading back
+ * the whole flash.
+ * Costs SPM_PAGESIZE bytes of RAM and some bytes of flash.
+ */
+
+#ifdef CONFIG_USE__MEMORY_CRC
+#	define USE_MEMORY_CRC		1
+#else
+#	define USE_MEMORY_CRC		0
+#endif
+/* If USE_MEMORY_CRC is defined to 1, the vendor requests
+ * USBASP_FUNC_GETFLASHCRC (65) and USBASP_FUNC_GETEEPROMCRC (66) return the
+ * CRC16-CCITT (avr-libc's _crc_ccitt_update(), start value 0xffff, 2 bytes
+ * little endian) of a memory range. wValue holds the start address (the
+ * upper bits are taken from USBASP_FUNC_SETLONGADDRESS, like for reading),
+ * wIndex the length in bytes (0 means 64 KB). A host can verify an image by
+ * comparing checksums instead of reading back all data.
+ * See tools/imagecrc.c for the host side reference.
+ */
+
+#ifdef CONFIG_USE__PAGE_DIGESTS
+#	define USE_PAGE_DIGESTS		1
+#else
+#	define USE_PAGE_DIGESTS		0
+#endif
+/* If USE_PAGE_DIGESTS is defined to 1, the vendor request
+ * USBASP_FUNC_GETPAGECRCS (67) streams one CRC16-CCITT (computed like
+ * USBASP_FUNC_GETFLASHCRC, 2 bytes little endian) per flash page, starting
+ * with the page of wValue (upper address bits from USBASP_FUNC_SETLONGADDRESS)
+ * for wLength/2 pages. A host can compare the table with the pages of the
+ * new image and only send the pages which differ (see tools/usbaspdelta.c).
+ */
+
+#ifdef CONFIG_USE__LONG_TRANSFERS
+#	define USE_LONG_TRANSFERS		1
+#else
+#	define USE_LONG_TRANSFERS		0
+#endif
+/* If USE_LONG_TRANSFERS is defined to 1, the USB driver is built with
+ * USB_CFG_LONG_TRANSFERS and READFLASH/WRITEFLASH/READEEPROM/WRITEEEPROM
+ * (and USBASP_FUNC_GETPAGECRCS) accept the full 16 bit wLength instead of
+ * at most 254 bytes. A host can then move a whole 256 byte page, or
+ * several pages, with a single SETUP. Costs some flash in the driver.
+ */
+
+#ifdef CONFIG_USE__ASM_PAGEFILL
+#	define USE_ASM_PAGEFILL		1
+#else
+#	define USE_ASM_PAGEFILL		0
+#endif
+/* If USE_ASM_PAGEFILL is defined to 1, the SPM page buffer is filled by
+ * a hand-optimized assembler kernel (pageFill() in main.c) which handles
+ * up to 8 bytes per call with one critical section per two words and
+ * 16 bit addressing, instead of a cli/boot_page_fill/sei sequence and
+ * 32 bit address arithmetic per word. Experimental: its size has not
+ * been checked with avr-gcc yet, so no target in Makefile.inc enables
+ * it.
+ */
+
+#ifdef CONFIG_USE__ZEROCOPY_READFLASH
+#	define USE_ZEROCOPY_READFLASH		1
+#else
+#	define USE_ZEROCOPY_READFLASH		0
+#endif
+/* If USE_ZEROCOPY_READFLASH is defined to 1, USBASP_FUNC_READFLASH hands
+ * the flash address to the USB driver as a ROM message (the way it sends
+ * its descriptors) instead of copying byte by byte in usbFunctionRead().
+ * On devices with more than 64 kBytes the 64 k page is taken from
+ * USBASP_FUNC_SETLONGADDRESS. Transfers crossing a 64 k boundary still
+ * take the usbFunctionRead() path.
+ */
+
+#ifdef CONFIG_USE__LZ_WRITE
+#	define USE_LZ_WRITE		1
+#else
+#	define USE_LZ_WRITE		0
+#endif
+/* If USE_LZ_WRITE is defined to 1, the vendor request
+ * USBASP_FUNC_WRITEFLASHLZ (68) accepts flash data as an LZSS stream
+ * (see tools/lzss.h) and decompresses it on the fly into the page buffer.
+ * Firmware images usually shrink by a third to a half, which saves the
+ * same share of the (slow) USB transfer time. Needs RAM for the window
+ * in addition to a page buffer: 2 kBytes on devices with 4 kBytes of RAM
+ * or more, 1 kByte with 2 kBytes and 256 bytes below (LZ_WINDOW_BITS in
+ * main.c, the uploader sends its window with every request and streams
+ * for another window are refused with a STALL).
+ */
+
+#ifdef CONFIG_USE__ISP_BATCH
+#	define USE_ISP_BATCH		1
+#else
+#	define USE_ISP_BATCH		0
+#endif
+/* If USE_ISP_BATCH is defined to 1, the vendor request
+ * USBASP_FUNC_TRANSMITBATCH (69) takes up to 16 ISP instructions of
+ * 4 bytes each in its OUT data stage and executes them like
+ * USBASP_FUNC_TRANSMIT. USBASP_FUNC_GETBATCHRESULTS (70) then returns the
+ * 4th answer byte of each instruction in one IN transfer. Reading the
+ * signature, fuses and lock bits takes 2 round trips instead of 7.
+ */
+
+#ifdef CONFIG_USE__EEPROM_QUEUE
+#	define USE_EEPROM_QUEUE		1
+#else
+#	define USE_EEPROM_QUEUE		0
+#endif
+/* If USE_EEPROM_QUEUE is defined to 1, EEPROM writes (paged and byte mode)
+ * go into a queue of 32 bytes which the main loop writes behind while USB
+ * keeps receiving. Further data is NAKed while the queue is nearly full,
+ * any request other than an EEPROM write (and leaving the boot loader)
+ * waits until the queue is empty. Needs 3 bytes of RAM per entry (address
+ * and data) plus 2 for its indices, 98 bytes for EEQUEUE_SIZE 32 (main.c).
+ */
+
+#ifdef CONFIG_USE__EEPROM_UPDATE
+#	define USE_EEPROM_UPDATE		1
+#else
+#	define USE_EEPROM_UPDATE		0
+#endif
+/* If USE_EEPROM_UPDATE is defined to 1, every EEPROM byte is read before
+ * it is written: unchanged bytes are skipped, and on devices with
+ * programming modes (EEPM bits, e.g. ATmega88/168/328/644) bytes which
+ * only clear bits are written without erase and 0xff is only erased,
+ * each in half the time of an erase and write.
+ */
+
+#ifdef CONFIG_USE__TRACE
+#	define USE_TRACE		1
+#else
+#	define USE_TRACE		0
+#endif
+/* If USE_TRACE is defined to 1, the boot loader records events of the
+ * programming path (SETUP received, page fill, erase, write, RWW enable,
+ * page skipped) with a timer 1 timestamp (F_CPU/64, free running while
+ * the boot loader is active) in a ring of TRACE_ENTRIES entries in RAM.
+ * The vendor request USBASP_FUNC_GETTRACE (71) returns the ring in one IN
+ * transfer, USBASP_FUNC_CONNECT clears it (see tools/trace.h for the
+ * format and tools/usbasptrace.c for a reader). Recording an event costs
+ * a few cycles and no USB bandwidth. Needs 2 + 4 * TRACE_ENTRIES bytes of
+ * RAM (63 entries on devices with 2 kBytes of RAM or more, 16 below).
+ */
+
+#ifdef CONFIG_USE__STATS
+#	define USE_STATS		1
+#else
+#	define USE_STATS		0
+#endif
+/* If USE_STATS is defined to 1, the boot loader counts where programming
+ * time goes. The vendor request USBASP_FUNC_GETSTATS (72) returns 28 bytes,
+ * little endian, times in timer 1 ticks of 64 cycles:
+ *   32 bit: time blocked waiting for SPM, time in usbFunctionWrite(),
+ *           time in usbFunctionRead()
+ *   16 bit: SETUPs handled, pages filled, erased, written and skipped
+ *           (identical or blank), EEPROM bytes programmed
+ *   16 bit: shortest page erase and page write seen on this chip (0xffff
+ *           if none yet); a slow chip shows aging flash
+ * USBASP_FUNC_CONNECT clears everything but the erase and write times.
+ * Needs 28 bytes of RAM and timer 1 (like USE_TRACE).
+ */
+
+#ifdef CONFIG_USE__CAPABILITIES
+#	define USE_CAPABILITIES		1
+#else
+#	define USE_CAPABILITIES		0
+#endif
+/* If USE_CAPABILITIES is defined to 1, USBASP_FUNC_GETCAPABILITIES (127)
+ * answers with the 4 capability bytes of a USBasp (all clear, no TPI)
+ * followed by a description of this build: version, page size, a bitmask
+ * of the CONFIG_USE__* extensions compiled in, flash, application and
+ * EEPROM size, LZ_WINDOW_BITS and the batch size (see tools/caps.h).
+ * AVRDUDE only reads the first 4 bytes; an uploader reading all of them
+ * can pick the fastest requests this build supports without being told.
+ * Needs 24 bytes of RAM.
+ */
+
+#ifdef CONFIG_USE__FAST_ENUMERATION
+#	define USE_FAST_ENUMERATION	1
+#else
+#	define USE_FAST_ENUMERATION	0
+#endif
+/* If USE_FAST_ENUMERATION is defined to 1, the fake USB disconnect before
+ * connecting holds D- low for USB_DISCONNECT_MS (default 10 ms, main.c),
+ * timed by timer 1, instead of 260 ms: a hub notices SE0 after 2.5 us and
+ * latches the change until the host asks. The reset flags do not tell
+ * whether the host has seen the device before (PORF stays set until
+ * software clears it), so the disconnect is never skipped.
+ * Needs timer 1 (like USE_TRACE).
+ */
+
 #ifndef CONFIG_NO__NEED_WATCHDOG
 #	define NEED_WATCHDOG		1
 #else
@@ -333,6 +613,20 @@ these macros are defined, the boot loader usees them.
  * (except registers and IO), since RESET will NOT clear old RAM content.
  */
 
+#ifdef CONFIG_USE__FAST_APPENTRY
+#	define USE_FAST_APPENTRY		1
+#else
+#	define USE_FAST_APPENTRY		0
+#endif
+/* This macro enables some (init1) code, executed at bootup before anything
+ * else: unless this was an external reset with the jumper closed, it jumps
+ * to the application right away, about 50 cycles after reset (see
+ * "make resetcycles"), instead of through RAM initialization, LED, USB
+ * and interrupt vector setup and back. It samples the jumper the way
+ * bootLoaderInit() and bootLoaderCondition() below do; if you change
+ * those, change __func_fastappentry() in main.c as well.
+ */
+
 //#define SIGNATURE_BYTES             0x1e, 0x93, 0x07, 0     /* ATMega8 */
 /* This macro defines the signature bytes returned by the emulated USBasp to
  * the programmer software. They should match the actual device at least in
@@ -0,0 +1,120 @@
+/* Name: bootloader.c
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Translation unit holding the unmodified boot loader (main.c including
+ * the C part of the USB driver). It exports the steps main() is built
+ * from (bootLoaderStart(), bootLoaderPoll(), bootLoaderFinish()) and a
+ * transaction level emulation of the driver's interrupt routine
+ * (usbdrvasm*.inc) to the hostsim driver.
+ */
+
+#include "../main.c"
+
+#include "hostsim.h"
+#include "usbemu.h"
+
+/*
+ * usbdrv.c references this in branches for USB_PROP_IS_DYNAMIC
+ * descriptors, which usbconfig.h does not use. Defining it keeps the
+ * "used but never defined" warning out of the host build.
+ */
+static usbMsgLen_t usbFunctionDescriptor(struct usbRequest *rq)
+{
+	(void)rq;
+	return 0;
+}
+
+/* the asm module is not part of the host build */
+unsigned (usbCrc16)(unsigned data, uchar len)
+{
+	uchar		*p = (uchar *)(uintptr_t)data;
+	unsigned	crc = 0xffff;
+	uchar		i;
+
+	while (len--) {
+		crc ^= *p++;
+		for (i = 0; i < 8; i++)
+			crc = (crc & 1) ? ((crc >> 1) ^ 0xa001) : (crc >> 1);
+	}
+	return crc ^ 0xffff;
+}
+
+unsigned (usbCrc16Append)(unsigned data, uchar len)
+{
+	unsigned	crc = usbCrc16(data, len);
+	uchar		*p = (uchar *)(uintptr_t)data;
+
+	p[len]		= crc;
+	p[len + 1]	= crc >> 8;
+	return crc;
+}
+
+uint64_t hostsim_bl_left;
+uint64_t hostsim_bl_attached;
+
+void hostsim_bl_start(uint8_t resetFlags)
+{
+	hostsim_bl_left = 0;
+	(void)resetFlags;
+	bootLoaderStart();
+	/* the device reattaches when D- is released */
+	hostsim_bl_attached = hostsim_now;
+}
+
+/* one iteration of the boot loader's main loop, idle once it has left */
+void hostsim_bl_poll(void)
+{
+	hostsim_now += 40;	/* rough cost of an idle usbPoll() */
+	if (hostsim_bl_left) {
+		hostsim_tick();
+		return;
+	}
+	if (!bootLoaderPoll()) {
+		bootLoaderFinish();
+		hostsim_bl_left = hostsim_now;
+	}
+	hostsim_tick();
+}
+
+/* ------------------------------------------------------------------------ */
+
+int usbemu_setup_or_out(uint8_t token, const uint8_t *data, uint8_t len)
+{
+	uint8_t *buf;
+
+	usbCurrentTok = token;
+	if (len == 0)			/* status stage, handled by the ISR */
+		return USBEMU_ACK;
+	if (usbRxLen != 0)
+		return USBEMU_NAK;
+	buf = usbRxBuf + usbInputBufOffset;
+	buf[0] = (token == USBPID_SETUP) ? USBPID_DATA0 : USBPID_DATA1;
+	memcpy(buf + 1, data, len);
+	usbRxLen		= len + 3;
+	usbRxToken		= token;
+	usbInputBufOffset	= USB_BUFSIZE - usbInputBufOffset;
+	return USBEMU_ACK;
+}
+
+int usbemu_in(uint8_t *data, uint8_t *len)
+{
+	uint8_t n;
+
+	if (usbRxLen > 0)		/* unprocessed input pending */
+		return USBEMU_NAK;
+	if (usbTxLen & 0x10) {		/* handshake only */
+		if (usbTxLen == USBPID_STALL)
+			return USBEMU_STALL;
+		return USBEMU_NAK;
+	}
+	n = usbTxLen - 4;
+	memcpy(data, usbTxBuf + 1, n);
+	*len		= n;
+	usbTxLen	= USBPID_NAK;
+	return USBEMU_ACK;
+}
@@ -0,0 +1,61 @@
+#!/bin/sh
+# Name: check.sh
+# Project: USBaspLoader (hostsim)
+# Creation Date: 2026-10-18
+# Tabsize: 4
+# License: GNU GPL v2 (see License.txt)
+#
+# Regression checks of the boot loader in hostsim, run from firmware/ by
+# "make hostsim-check". Every case builds hostsim for one device and set
+# of CONFIG_ defines, runs one session with app.hex (a synthetic 6 kByte
+# firmware image) and looks for lines of the report.
+
+MAKE=${MAKE:-make}
+APP=hostsim/app.hex
+OUT=hostsim/check.out
+failed=0
+
+# build device defines
+build()
+{
+	rm -f hostsim/bootloader.o hostsim/hostsim
+	$MAKE -s hostsim DEVICE="$1" DEFINES="$2" > /dev/null || exit 1
+	config="$1 $2"
+}
+
+# run hostsim-options..., the exit status is checked by the patterns
+run()
+{
+	hostsim/hostsim "$@" $APP > $OUT 2>&1
+	options="$*"
+}
+
+# expect description pattern
+expect()
+{
+	if grep -q -e "$2" $OUT; then
+		echo "ok      $1"
+	else
+		echo "FAILED  $1 ($config, $options: no \"$2\")"
+		failed=1
+	fi
+}
+
+build atmega2560 "-DCONFIG_USE__LZ_WRITE"
+run -F -z 11
+expect "LZ upload with the window of the device" "^result: *ok"
+run -F -z 8
+expect "LZ upload with a smaller window is refused" "^delta upload: *transfer error"
+expect "nothing written by the refused stream" "^flash: *0 erases"
+run -F -z 12
+expect "LZ upload with a larger window is refused" "^delta upload: *transfer error"
+
+build atmega328p "-DCONFIG_USE__BACKGROUND_CHIPERASE"
+run -e -A		# a few transactions (< 10 ms), not the whole erase
+expect "program enable does not wait for the background chip erase" "^program enable: *[0-9]\.[0-9]* ms"
+expect "upload after the background chip erase" "^result: *ok"
+run -e -A -P
+expect "RDY/BSY poll after the background chip erase" "^result: *ok"
+
+rm -f $OUT hostsim/bootloader.o hostsim/hostsim
+exit $failed
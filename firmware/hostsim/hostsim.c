@@ -0,0 +1,638 @@
+/* Name: hostsim.c
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Host-native simulation of a programming session.
+ *
+ * The boot loader's protocol core (main.c with the C part of V-USB) runs
+ * against the device model of model.c, while this file plays the host:
+ * it replays the control transfers AVRDUDE issues for a USBasp and
+ * reports the simulated duration, the SPM activity per page and the bus
+ * traffic. Time advances with every USB transaction attempt (including
+ * NAKed ones) and with every busy wait of the device.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "hostsim.h"
+#include "usbemu.h"
+#include "ihex.h"
+#include "memcrc.h"
+#include "delta.h"
+#include "trace.h"
+#include "caps.h"
+
+/* USBasp requests as issued by AVRDUDE */
+#define FUNC_CONNECT		1
+#define FUNC_DISCONNECT		2
+#define FUNC_TRANSMIT		3
+#define FUNC_READFLASH		4
+#define FUNC_ENABLEPROG		5
+#define FUNC_WRITEFLASH		6
+#define FUNC_READEEPROM		7
+#define FUNC_WRITEEEPROM	8
+#define FUNC_SETLONGADDRESS	9
+#define FUNC_GETVERIFYSTATUS	64
+#define FUNC_GETFLASHCRC	65
+#define FUNC_GETEEPROMCRC	66
+#define FUNC_TRANSMITBATCH	69
+#define FUNC_GETBATCHRESULTS	70
+#define FUNC_GETSTATS		72
+
+#define BLOCKFLAG_FIRST		1
+#define BLOCKFLAG_LAST		2
+
+#define MAXBLOCKSIZE		4096
+static uint32_t		READBLOCKSIZE = 200, WRITEBLOCKSIZE = 200;
+#define CHIP_ERASE_DELAY_US	9000
+#define HOSTSIM_IDLE_US		1000000	/* after DISCONNECT, longer than any exit delay */
+
+#define RQ_IN			0xc0	/* vendor, device, device-to-host */
+#define RQ_OUT			0x40	/* vendor, device, host-to-device */
+#define RQ_STD_IN		0x80	/* standard, device, device-to-host */
+#define RQ_STD_OUT		0x00	/* standard, device, host-to-device */
+
+#define USBRQ_SET_ADDRESS	5
+#define USBRQ_GET_DESCRIPTOR	6
+#define USBRQ_SET_CONFIGURATION	9
+#define USBDESCR_DEVICE		1
+#define USBDESCR_CONFIG		2
+
+#define USB_TATTDB_US		100000	/* attach debounce of the host */
+#define USB_TDRST_US		10000	/* port reset */
+#define USB_TRSTRCY_US		10000	/* reset recovery (and after SET_ADDRESS) */
+
+typedef struct busstats {
+	uint32_t	setups;
+	uint32_t	transactions;
+	uint32_t	naks;
+	uint32_t	bytes_out;
+	uint32_t	bytes_in;
+} busstats_t;
+
+static busstats_t	bus;
+static uint64_t		hostTime;
+static uint32_t		usPerTransaction = 1000;
+static int		verbose;
+
+static uint8_t		image[HOSTSIM_FLASHSIZE];
+static uint8_t		imageUsed[HOSTSIM_FLASHSIZE];
+static uint8_t		eeImage[HOSTSIM_EEPROMSIZE];
+static uint8_t		eeImageUsed[HOSTSIM_EEPROMSIZE];
+
+/* packet buffers of the host side */
+static uint8_t		setupPacket[8];
+static uint8_t		dataPacket[8];
+
+/* ------------------------------------------------------------------------ */
+
+static uint64_t us2cycles(uint64_t us)
+{
+	return us * (F_CPU / 1000000UL);
+}
+
+static double cycles2ms(uint64_t cycles)
+{
+	return (double)cycles * 1e3 / (double)F_CPU;
+}
+
+/* let the device run until the host issues its next transaction */
+static void nextTransaction(void)
+{
+	hostTime += us2cycles(usPerTransaction);
+	while (hostsim_now < hostTime)
+		hostsim_bl_poll();
+	hostTime = hostsim_now;
+	bus.transactions++;
+}
+
+static void hostSleep(uint32_t us)
+{
+	hostTime += us2cycles(us);
+	while (hostsim_now < hostTime)
+		hostsim_bl_poll();
+}
+
+static void sendSetup(uint8_t type, uint8_t request, uint16_t value, uint16_t index, uint16_t length)
+{
+	setupPacket[0] = type;
+	setupPacket[1] = request;
+	setupPacket[2] = value;
+	setupPacket[3] = value >> 8;
+	setupPacket[4] = index;
+	setupPacket[5] = index >> 8;
+	setupPacket[6] = length;
+	setupPacket[7] = length >> 8;
+	bus.setups++;
+	for (;;) {
+		nextTransaction();
+		if (usbemu_setup_or_out(USBEMU_PID_SETUP, setupPacket, 8) == USBEMU_ACK)
+			break;
+		bus.naks++;
+	}
+}
+
+static int controlInType(uint8_t type, uint8_t request, uint16_t value, uint16_t index, uint8_t *buf,
+			 uint16_t length)
+{
+	uint16_t	got = 0;
+	uint8_t		n;
+	int		rc;
+
+	sendSetup(type, request, value, index, length);
+	for (;;) {
+		nextTransaction();
+		rc = usbemu_in(dataPacket, &n);
+		if (rc == USBEMU_NAK) {
+			bus.naks++;
+			continue;
+		}
+		if (rc == USBEMU_STALL)
+			return -1;
+		if (got + n > length)
+			n = length - got;
+		memcpy(buf + got, dataPacket, n);
+		got += n;
+		bus.bytes_in += n;
+		if ((n < 8) || (got >= length))
+			break;
+	}
+	nextTransaction();	/* status stage */
+	usbemu_setup_or_out(USBEMU_PID_OUT, NULL, 0);
+	return got;
+}
+
+static int controlOutType(uint8_t type, uint8_t request, uint16_t value, uint16_t index, const uint8_t *buf,
+			  uint16_t length)
+{
+	uint16_t	sent = 0;
+	uint8_t		n;
+	int		rc;
+
+	sendSetup(type, request, value, index, length);
+	while (sent < length) {
+		n = ((length - sent) > 8) ? 8 : (length - sent);
+		memcpy(dataPacket, buf + sent, n);
+		nextTransaction();
+		if (usbemu_setup_or_out(USBEMU_PID_OUT, dataPacket, n) != USBEMU_ACK) {
+			bus.naks++;
+			continue;
+		}
+		sent += n;
+		bus.bytes_out += n;
+	}
+	for (;;) {		/* status stage */
+		nextTransaction();
+		rc = usbemu_in(dataPacket, &n);
+		if (rc == USBEMU_NAK) {
+			bus.naks++;
+			continue;
+		}
+		return (rc == USBEMU_ACK) ? sent : -1;
+	}
+}
+
+static int controlIn(uint8_t request, uint16_t value, uint16_t index, uint8_t *buf, uint16_t length)
+{
+	return controlInType(RQ_IN, request, value, index, buf, length);
+}
+
+static int controlOut(uint8_t request, uint16_t value, uint16_t index, const uint8_t *buf, uint16_t length)
+{
+	return controlOutType(RQ_OUT, request, value, index, buf, length);
+}
+
+/*
+ * What a host does with a device attached at cycle attached: debounce,
+ * port reset and recovery (the spec minimums), then the requests Linux
+ * issues for a low speed device. Returns the number of descriptor bytes.
+ */
+static int enumerate(uint64_t attached)
+{
+	uint8_t	buf[256];
+	int	n = 0, rc;
+
+	if (hostTime < attached)
+		hostTime = attached;
+	hostSleep(USB_TATTDB_US + USB_TDRST_US + USB_TRSTRCY_US);
+	n += controlInType(RQ_STD_IN, USBRQ_GET_DESCRIPTOR, USBDESCR_DEVICE << 8, 0, buf, 64);
+	controlOutType(RQ_STD_OUT, USBRQ_SET_ADDRESS, 1, 0, NULL, 0);
+	hostSleep(USB_TRSTRCY_US);
+	n += controlInType(RQ_STD_IN, USBRQ_GET_DESCRIPTOR, USBDESCR_DEVICE << 8, 0, buf, 18);
+	if ((rc = controlInType(RQ_STD_IN, USBRQ_GET_DESCRIPTOR, USBDESCR_CONFIG << 8, 0, buf, 9)) == 9)
+		rc = controlInType(RQ_STD_IN, USBRQ_GET_DESCRIPTOR, USBDESCR_CONFIG << 8, 0, buf,
+				   buf[2] | (buf[3] << 8));
+	n += rc;
+	controlOutType(RQ_STD_OUT, USBRQ_SET_CONFIGURATION, 1, 0, NULL, 0);
+	return n;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static uint8_t transmit(uint8_t c0, uint8_t c1, uint8_t c2, uint8_t c3)
+{
+	uint8_t res[4] = { 0, 0, 0, 0 };
+
+	controlIn(FUNC_TRANSMIT, c0 | (c1 << 8), c2 | (c3 << 8), res, 4);
+	return res[3];
+}
+
+static void setLongAddress(uint32_t address)
+{
+	uint8_t res[4];
+
+	controlIn(FUNC_SETLONGADDRESS, address & 0xffff, address >> 16, res, 4);
+}
+
+static uint16_t blockIndex(uint16_t pagesize, uint8_t flags)
+{
+	return (pagesize & 0xff) | ((((flags & 0x0f) + ((pagesize & 0xf00) >> 4))) << 8);
+}
+
+/* the way AVRDUDE's avr_write() drives usbasp_spi_paged_write() */
+static void writeMemory(uint8_t request, const uint8_t *data, const uint8_t *used, uint32_t size, uint16_t pagesize)
+{
+	uint32_t	page, addr, n, block;
+	uint8_t		flags;
+
+	uint32_t	step = pagesize;
+
+	/* long transfers: several pages per SETUP */
+	if (WRITEBLOCKSIZE > pagesize)
+		step = (WRITEBLOCKSIZE / pagesize) * pagesize;
+	for (page = 0; page < size; page += step) {
+		if (step > pagesize) {
+			for (addr = page; addr < page + step && addr < size; addr++)
+				if (used[addr]) break;
+			if (addr == page + step || addr == size)
+				continue;
+			n = (size - page < step) ? (size - page) : step;
+			setLongAddress(page);
+			controlOut(request, page & 0xffff, blockIndex(pagesize, BLOCKFLAG_FIRST | BLOCKFLAG_LAST),
+				   data + page, n);
+			continue;
+		}
+		for (addr = page; addr < page + pagesize; addr++)
+			if (used[addr]) break;
+		if (addr == page + pagesize)
+			continue;
+		flags = BLOCKFLAG_FIRST;
+		for (addr = page, n = pagesize; n > 0; addr += block, n -= block) {
+			block = (n > WRITEBLOCKSIZE) ? WRITEBLOCKSIZE : n;
+			if (block == n)
+				flags |= BLOCKFLAG_LAST;
+			setLongAddress(addr);
+			controlOut(request, addr & 0xffff, blockIndex(pagesize, flags), data + addr, block);
+			flags = 0;
+		}
+	}
+}
+
+static uint32_t verifyMemory(uint8_t request, const uint8_t *data, const uint8_t *used, uint32_t size, uint16_t pagesize)
+{
+	uint8_t		buf[MAXBLOCKSIZE];
+	uint32_t	page, addr, n, block, i, errors = 0;
+
+	for (page = 0; page < size; page += pagesize) {
+		for (addr = page; addr < page + pagesize; addr++)
+			if (used[addr]) break;
+		if (addr == page + pagesize)
+			continue;
+		for (addr = page, n = pagesize; n > 0; addr += block, n -= block) {
+			block = (n > READBLOCKSIZE) ? READBLOCKSIZE : n;
+			setLongAddress(addr);
+			controlIn(request, addr & 0xffff, 0, buf, block);
+			for (i = 0; i < block; i++)
+				if (used[addr + i] && (buf[i] != data[addr + i])) {
+					if (!errors)
+						fprintf(stderr, "verify error at 0x%05lx: 0x%02x != 0x%02x\n",
+							(unsigned long)(addr + i), buf[i], data[addr + i]);
+					errors++;
+				}
+		}
+	}
+	return errors;
+}
+
+/* ------------------------------------------------------------------------ */
+
+static void phase(const char *name, uint64_t *start, busstats_t *startBus)
+{
+	printf("  %-12s %10.1f ms  %6lu setups  %7lu transactions  %6lu NAKs\n", name,
+		cycles2ms(hostsim_now - *start),
+		(unsigned long)(bus.setups - startBus->setups),
+		(unsigned long)(bus.transactions - startBus->transactions),
+		(unsigned long)(bus.naks - startBus->naks));
+	*start		= hostsim_now;
+	*startBus	= bus;
+}
+
+static int deltaIn(void *ctx, uint8_t r, uint16_t v, uint16_t i, uint8_t *b, uint16_t l)
+{
+	return controlIn(r, v, i, b, l);
+}
+
+static int deltaOut(void *ctx, uint8_t r, uint16_t v, uint16_t i, const uint8_t *b, uint16_t l)
+{
+	return controlOut(r, v, i, b, l);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [options] flash.hex\n"
+		"  -p file.hex  flash content before the session (previous firmware)\n"
+		"  -E file.hex  also write this EEPROM image\n"
+		"  -Q file.hex  EEPROM content before the session\n"
+		"  -e           issue a chip erase first (AVRDUDE without -D)\n"
+		"  -P           poll RDY/BSY after the chip erase instead of sleeping\n"
+		"  -A           send a program enable (0xac 0x53) right after the chip erase\n"
+		"  -V           do not verify (AVRDUDE -V)\n"
+		"  -d           ask the device for its verify status instead of reading back\n"
+		"  -c           compare checksums of the device instead of reading back\n"
+		"  -w page      page which gets a bit flipped when written (fault injection)\n"
+		"  -t us        duration of one USB transaction (default %lu)\n"
+		"  -b bytes     block size of read/write transfers (default 200, AVRDUDE)\n"
+		"  -I           also read fuses and lock bits when connecting\n"
+		"  -B           read signature, fuses and lock bits with one batch\n"
+		"  -D           delta upload (page digests, see tools/delta.c)\n"
+		"  -F           upload all pages through tools/delta.c\n"
+		"  -z bits      LZ compressed upload with a window of 1 << bits bytes\n"
+		"  -T           print the event trace of the device (CONFIG_USE__TRACE)\n"
+		"  -S           print the counters of the device (CONFIG_USE__STATS)\n"
+		"  -C           print the capabilities of the device (CONFIG_USE__CAPABILITIES)\n"
+		"  -R           enumerate after the reset (button) which started the boot loader\n"
+		"  -v           list erase/write counts of every page\n",
+		prog, (unsigned long)usPerTransaction);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	uint64_t	start, session, exitStart, disconnected, enableTime = 0;
+	busstats_t	startBus;
+	uint8_t		sig[3], fuses[16];
+	const char	*preload = NULL, *eeFile = NULL;
+	const char	*eePreload = NULL;
+	int		reset = 0, chipErase = 0, pollReady = 0, enableAfterErase = 0, verify = 1, deviceVerify = 0, crcVerify = 0, opt;
+	int		delta = 0, deltaFlags = 0, lzBits = 8, batch = 0, identify = 0, trace = 0, stats = 0, caps = 0;
+	uint32_t	i, errors = 0, pagesUsed = 0, erased = 0, written = 0, multi = 0;
+
+	while ((opt = getopt(argc, argv, "p:E:Q:ePAVdcw:t:vIBDb:Fz:TSCR")) != -1) {
+		switch (opt) {
+		case 'p': preload = optarg;				break;
+		case 'E': eeFile = optarg;				break;
+		case 'Q': eePreload = optarg;				break;
+		case 'e': chipErase = 1;				break;
+		case 'P': pollReady = 1;				break;
+		case 'A': enableAfterErase = 1;				break;
+		case 'V': verify = 0;					break;
+		case 'd': deviceVerify = 1; verify = 0;			break;
+		case 'c': crcVerify = 1; verify = 0;			break;
+		case 'w': hostsim_weak_page = strtol(optarg, NULL, 0);	break;
+		case 't': usPerTransaction = strtoul(optarg, NULL, 0);	break;
+		case 'v': verbose = 1;					break;
+		case 'b': READBLOCKSIZE = WRITEBLOCKSIZE = strtoul(optarg, NULL, 0);	break;
+		case 'I': identify = 1;					break;
+		case 'B': batch = 1;					break;
+		case 'D': delta = 1; verify = 0;			break;
+		case 'F': delta = 1; deltaFlags |= DELTA_FULL;		break;
+		case 'z': deltaFlags |= DELTA_LZ; lzBits = strtol(optarg, NULL, 0); break;
+		case 'T': trace = 1;					break;
+		case 'S': stats = 1;					break;
+		case 'C': caps = 1;					break;
+		case 'R': reset = 1;					break;
+		default:  usage(argv[0]);
+		}
+	}
+	if (optind != argc - 1)
+		usage(argv[0]);
+
+	hostsim_reset();
+	if (preload && (ihex_read(preload, hostsim_flash, NULL, HOSTSIM_FLASHSIZE) < 0))
+		return 1;
+	memset(image, 0xff, sizeof(image));
+	if (ihex_read(argv[optind], image, imageUsed, BOOTLOADER_ADDRESS) < 0)
+		return 1;
+	memset(eeImage, 0xff, sizeof(eeImage));
+	if (eeFile && (ihex_read(eeFile, eeImage, eeImageUsed, HOSTSIM_EEPROMSIZE) < 0))
+		return 1;
+	for (i = 0; i < HOSTSIM_PAGES; i++) {
+		uint32_t a;
+		for (a = i * SPM_PAGESIZE; a < (i + 1) * SPM_PAGESIZE; a++)
+			if (imageUsed[a]) { pagesUsed++; break; }
+	}
+
+	if (eePreload && (ihex_read(eePreload, hostsim_eeprom, NULL, HOSTSIM_EEPROMSIZE) < 0))
+		return 1;
+	/* the boot loader only starts after an external reset */
+	hostsim_bl_start(_BV(EXTRF));
+
+	printf("hostsim: %s, %lu bytes flash, %u bytes/page, F_CPU %lu Hz, %lu us/transaction\n",
+		HOSTSIM_DEVICE, (unsigned long)HOSTSIM_FLASHSIZE, SPM_PAGESIZE,
+		(unsigned long)F_CPU, (unsigned long)usPerTransaction);
+	printf("image:   %lu pages with data\n\n", (unsigned long)pagesUsed);
+
+	if (reset) {
+		int n = enumerate(hostsim_bl_attached);
+
+		printf("enumerated:        %.1f ms after the reset, attached at %.1f ms, %d descriptor bytes\n",
+			cycles2ms(hostsim_now), cycles2ms(hostsim_bl_attached), n);
+		memset(&bus, 0, sizeof(bus));
+	}
+	start = session = hostsim_now;
+	startBus = bus;
+
+	controlIn(FUNC_CONNECT, 0, 0, dataPacket, 4);
+	controlIn(FUNC_ENABLEPROG, 0, 0, dataPacket, 4);
+	if (caps) {
+		uint8_t	buf[CAPS_SIZE];
+		caps_t	c;
+
+		if (caps_parse(buf, controlIn(USBASP_FUNC_GETCAPABILITIES, 0, 0, buf, sizeof(buf)), &c) < 0) {
+			printf("capabilities:      not supported\n");
+		} else {
+			printf("capabilities:      ");
+			caps_print(stdout, &c);
+		}
+	}
+	if (batch) {
+		/* signature, low/high/extended fuse and lock bits */
+		static const uint8_t cmds[7 * 4] = {
+			0x30, 0, 0, 0,	0x30, 0, 1, 0,	0x30, 0, 2, 0,
+			0x50, 0, 0, 0,	0x58, 8, 0, 0,	0x50, 8, 0, 0,	0x58, 0, 0, 0
+		};
+
+		controlOut(FUNC_TRANSMITBATCH, 0, 0, cmds, sizeof(cmds));
+		if (controlIn(FUNC_GETBATCHRESULTS, 0, 0, fuses, sizeof(fuses)) != 7) {
+			printf("batch:             not supported\n");
+			return 1;
+		}
+		memcpy(sig, fuses, 3);
+	} else {
+		for (i = 0; i < 3; i++)
+			sig[i] = transmit(0x30, 0, i, 0);
+		if (identify) {
+			fuses[3] = transmit(0x50, 0, 0, 0);
+			fuses[4] = transmit(0x58, 8, 0, 0);
+			fuses[5] = transmit(0x50, 8, 0, 0);
+			fuses[6] = transmit(0x58, 0, 0, 0);
+		}
+	}
+	if (batch || identify)
+		printf("fuses:             low %02x high %02x ext %02x lock %02x\n",
+			fuses[3], fuses[4], fuses[5], fuses[6]);
+	phase("connect", &start, &startBus);
+	if (chipErase) {
+		transmit(0xac, 0x80, 0, 0);
+		if (enableAfterErase) {
+			enableTime = hostsim_now;
+			transmit(0xac, 0x53, 0, 0);
+			enableTime = hostsim_now - enableTime;
+		}
+		if (pollReady) {
+			while (transmit(0xf0, 0, 0, 0) & 1)
+				;
+		} else {
+			hostSleep(CHIP_ERASE_DELAY_US);
+		}
+		controlIn(FUNC_ENABLEPROG, 0, 0, dataPacket, 4);
+		phase("chip erase", &start, &startBus);
+	}
+	if (delta) {
+		delta_transport_t t = { deltaIn, deltaOut, NULL, WRITEBLOCKSIZE > 254 ? WRITEBLOCKSIZE : 254, lzBits };
+		delta_stats_t ds;
+		if (delta_upload(&t, image, imageUsed, BOOTLOADER_ADDRESS, SPM_PAGESIZE, deltaFlags, &ds) < 0)
+			printf("delta upload:      transfer error\n"), errors++;
+		else
+			printf("delta upload:      %lu pages, %lu sent (%lu bytes), %lu failed\n", (unsigned long)ds.pages,
+				(unsigned long)ds.written, (unsigned long)ds.bytes, (unsigned long)ds.failed);
+	} else
+	writeMemory(FUNC_WRITEFLASH, image, imageUsed, BOOTLOADER_ADDRESS, SPM_PAGESIZE);
+	phase("write flash", &start, &startBus);
+	if (eeFile) {
+		writeMemory(FUNC_WRITEEEPROM, eeImage, eeImageUsed, HOSTSIM_EEPROMSIZE, 4);
+		phase("write eeprom", &start, &startBus);
+	}
+	if (verify) {
+		errors = verifyMemory(FUNC_READFLASH, image, imageUsed, BOOTLOADER_ADDRESS, SPM_PAGESIZE);
+		if (eeFile)
+			errors += verifyMemory(FUNC_READEEPROM, eeImage, eeImageUsed, HOSTSIM_EEPROMSIZE, 4);
+		phase("verify", &start, &startBus);
+	}
+	if (crcVerify) {
+		uint32_t a, n, end = BOOTLOADER_ADDRESS;
+		uint8_t  c[2];
+
+		while (end && !imageUsed[end - 1])
+			end--;
+		for (a = 0; a < end; a += n) {
+			n = ((end - a) > 0x10000) ? 0x10000 : (end - a);
+			setLongAddress(a);
+			if (controlIn(FUNC_GETFLASHCRC, a & 0xffff, n & 0xffff, c, 2) != 2) {
+				printf("crc verify:        not supported\n");
+				break;
+			}
+			if ((c[0] | (c[1] << 8)) != memcrc(0xffff, image + a, n)) {
+				printf("crc verify:        mismatch in 0x%05lx..0x%05lx\n",
+					(unsigned long)a, (unsigned long)(a + n - 1));
+				errors++;
+			}
+		}
+		phase("crc verify", &start, &startBus);
+	}
+	if (deviceVerify) {
+		uint8_t st[6];
+		int	n = controlIn(FUNC_GETVERIFYSTATUS, 0, 0, st, sizeof(st));
+		phase("dev verify", &start, &startBus);
+		if (n != 6) {
+			printf("device verify:     not supported\n");
+		} else {
+			printf("device verify:     %u failed pages, first at 0x%05lx\n", st[4] | (st[5] << 8),
+				(unsigned long)(st[0] | (st[1] << 8) | (st[2] << 16) | ((uint32_t)st[3] << 24)));
+		}
+	}
+	if (trace) {
+		uint8_t buf[2 + 4 * 255];
+		int	n = controlIn(USBASP_FUNC_GETTRACE, 0, 0, buf, sizeof(buf));
+
+		printf("\ntrace:\n");
+		if (trace_print(stdout, buf, n, F_CPU / 1000) < 0)
+			printf("  not supported\n");
+	}
+	if (stats) {
+		uint8_t st[28];
+		double	us = 64e6 / F_CPU;	/* per timer 1 tick */
+
+		printf("\ndevice counters:\n");
+		if (controlIn(FUNC_GETSTATS, 0, 0, st, sizeof(st)) != sizeof(st)) {
+			printf("  not supported\n");
+		} else {
+#define ST32(i)	(st[i] | (st[i+1] << 8) | (st[i+2] << 16) | ((uint32_t)st[i+3] << 24))
+#define ST16(i)	(st[i] | (st[i+1] << 8))
+			printf("  spm wait %.1f ms, usbFunctionWrite %.1f ms, usbFunctionRead %.1f ms\n",
+				ST32(0) * us / 1e3, ST32(4) * us / 1e3, ST32(8) * us / 1e3);
+			printf("  %u setups, pages: %u filled, %u erased, %u written, %u skipped, %u EEPROM bytes\n",
+				ST16(12), ST16(14), ST16(16), ST16(18), ST16(20), ST16(22));
+			if (ST16(24) != 0xffff)
+				printf("  page erase %.0f us\n", ST16(24) * us);
+			if (ST16(26) != 0xffff)
+				printf("  page write %.0f us\n", ST16(26) * us);
+		}
+	}
+	exitStart = hostsim_now;
+	controlIn(FUNC_DISCONNECT, 0, 0, dataPacket, 4);
+	disconnected = hostsim_now;
+	/* give the device the time to finish whatever it has queued */
+	hostSleep(HOSTSIM_IDLE_US);
+
+	for (i = 0; i < HOSTSIM_PAGES; i++) {
+		if (hostsim_stats.page_erases[i]) erased++;
+		if (hostsim_stats.page_writes[i]) written++;
+		if ((hostsim_stats.page_erases[i] > 1) || (hostsim_stats.page_writes[i] > 1)) multi++;
+		if (verbose && (hostsim_stats.page_erases[i] || hostsim_stats.page_writes[i]))
+			printf("  page 0x%05lx: %lu erases, %lu writes\n", (unsigned long)i * SPM_PAGESIZE,
+				(unsigned long)hostsim_stats.page_erases[i],
+				(unsigned long)hostsim_stats.page_writes[i]);
+	}
+	for (i = 0; i < BOOTLOADER_ADDRESS; i++)
+		if (imageUsed[i] && (hostsim_flash[i] != image[i]))
+			errors++;
+
+	printf("\nsignature:         %02x %02x %02x\n", sig[0], sig[1], sig[2]);
+	printf("session time:      %.1f ms (without final %lu ms idle)\n", cycles2ms(disconnected - session),
+		(unsigned long)HOSTSIM_IDLE_US / 1000);
+	if (hostsim_bl_left)
+		printf("exit latency:      %.3f ms from sending DISCONNECT to the application\n",
+			cycles2ms(hostsim_bl_left - exitStart));
+	else
+		printf("exit latency:      still in the boot loader after %lu ms\n",
+			(unsigned long)HOSTSIM_IDLE_US / 1000);
+	if (chipErase && enableAfterErase)
+		printf("program enable:    %.3f ms right after the chip erase\n", cycles2ms(enableTime));
+	printf("bus:               %lu setups, %lu transactions, %lu NAKs, %lu bytes out, %lu bytes in\n",
+		(unsigned long)bus.setups, (unsigned long)bus.transactions, (unsigned long)bus.naks,
+		(unsigned long)bus.bytes_out, (unsigned long)bus.bytes_in);
+	printf("flash:             %lu erases on %lu pages, %lu writes on %lu pages, %lu pages touched more than once\n",
+		(unsigned long)hostsim_stats.erases, (unsigned long)erased,
+		(unsigned long)hostsim_stats.writes, (unsigned long)written, (unsigned long)multi);
+	printf("setup overhead:    %.2f setups/KB written\n", bus.bytes_out ? bus.setups * 1024.0 / bus.bytes_out : 0.0);
+	printf("spm busy:          %.1f ms\n", cycles2ms(hostsim_stats.spm_cycles));
+	printf("eeprom:            %lu erase+write, %lu erase-only, %lu write-only operations, %.1f ms busy\n",
+		(unsigned long)hostsim_stats.ee_atomic_ops, (unsigned long)hostsim_stats.ee_erase_ops,
+		(unsigned long)hostsim_stats.ee_write_ops, cycles2ms(hostsim_stats.ee_cycles));
+	printf("violations:        %lu SPM while busy, %lu RWW reads while busy, %lu EEPROM during SPM, %lu SPM with interrupts\n",
+		(unsigned long)hostsim_stats.spm_violations, (unsigned long)hostsim_stats.rww_read_violations,
+		(unsigned long)hostsim_stats.ee_violations, (unsigned long)hostsim_stats.spm_with_interrupts);
+	printf("result:            %s (%lu mismatching bytes)\n", errors ? "FAILED" : "ok", (unsigned long)errors);
+
+	return (errors || hostsim_stats.spm_violations || hostsim_stats.rww_read_violations ||
+		hostsim_stats.ee_violations) ? 1 : 0;
+}
@@ -0,0 +1,55 @@
+/* Name: hostsim.h
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+#ifndef __hostsim_h_included__
+#define __hostsim_h_included__
+
+#include <stdint.h>
+#include <avr/io.h>
+#include <avr/boot.h>
+
+#define HOSTSIM_FLASHSIZE	((uint32_t)(FLASHEND) + 1)
+#define HOSTSIM_EEPROMSIZE	((uint32_t)(E2END) + 1)
+#define HOSTSIM_PAGES		(HOSTSIM_FLASHSIZE / SPM_PAGESIZE)
+#define HOSTSIM_NRWW_START	((uint32_t)(BOOTLOADER_ADDRESS))
+
+typedef struct hostsim_timing {
+	uint32_t	erase_us;
+	uint32_t	write_us;
+	uint32_t	ee_atomic_us;
+	uint32_t	ee_erase_us;
+	uint32_t	ee_write_us;
+} hostsim_timing_t;
+
+typedef struct hostsim_stats {
+	uint32_t	page_erases[HOSTSIM_PAGES];
+	uint32_t	page_writes[HOSTSIM_PAGES];
+	uint32_t	fills;
+	uint32_t	erases;
+	uint32_t	writes;
+	uint64_t	spm_cycles;
+	uint32_t	ee_atomic_ops;
+	uint32_t	ee_erase_ops;
+	uint32_t	ee_write_ops;
+	uint64_t	ee_cycles;
+	uint32_t	spm_violations;
+	uint32_t	spm_with_interrupts;
+	uint32_t	rww_read_violations;
+	uint32_t	ee_violations;
+} hostsim_stats_t;
+
+extern uint64_t		hostsim_now;
+extern uint8_t		hostsim_flash[HOSTSIM_FLASHSIZE];
+extern uint8_t		hostsim_eeprom[HOSTSIM_EEPROMSIZE];
+extern hostsim_stats_t	hostsim_stats;
+extern hostsim_timing_t	hostsim_timing;
+extern int32_t		hostsim_weak_page;
+
+extern void		hostsim_reset(void);
+extern void		hostsim_tick(void);
+
+#endif /* __hostsim_h_included__ */
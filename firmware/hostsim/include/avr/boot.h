@@ -0,0 +1,51 @@
+/* Name: boot.h
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Host replacement of <avr/boot.h>: every SPM operation is handed to the
+ * flash model, which keeps the temporary page buffer, the RWW-busy state
+ * and the erase/write timing of the device.
+ */
+
+#ifndef __hostsim_avr_boot_h_included__
+#define __hostsim_avr_boot_h_included__
+
+#include <stdint.h>
+#include <avr/io.h>
+
+#define __SPM_REG			SPMCSR
+#define __BOOT_PAGE_FILL		_BV(SPMEN)
+
+#define GET_LOW_FUSE_BITS		(0x0000)
+#define GET_LOCK_BITS			(0x0001)
+#define GET_EXTENDED_FUSE_BITS		(0x0002)
+#define GET_HIGH_FUSE_BITS		(0x0003)
+
+extern void	hostsim_spm(uint8_t spmcsr, uint32_t address, uint16_t data);
+extern uint8_t	hostsim_spm_busy(void);
+extern uint8_t	hostsim_rww_busy(void);
+extern uint8_t	hostsim_fuse(uint16_t which);
+
+#define boot_page_fill(address, data)	hostsim_spm(_BV(SPMEN), (uint32_t)(address), (uint16_t)(data))
+#define boot_page_erase(address)	hostsim_spm(_BV(PGERS) | _BV(SPMEN), (uint32_t)(address), 0)
+#define boot_page_write(address)	hostsim_spm(_BV(PGWRT) | _BV(SPMEN), (uint32_t)(address), 0)
+#define boot_rww_enable()		hostsim_spm(_BV(RWWSRE) | _BV(SPMEN), 0, 0)
+#define boot_page_fill_extended		boot_page_fill
+#define boot_page_erase_extended	boot_page_erase
+#define boot_page_write_extended	boot_page_write
+
+#define boot_spm_busy()			hostsim_spm_busy()
+#define boot_spm_busy_wait()		do { } while (boot_spm_busy())
+#define boot_rww_busy()			hostsim_rww_busy()
+#define boot_lock_fuse_bits_get(address) hostsim_fuse(address)
+
+#define boot_page_fill_safe(address, data) do { boot_spm_busy_wait(); boot_page_fill(address, data); } while (0)
+#define boot_page_erase_safe(address)	do { boot_spm_busy_wait(); boot_page_erase(address); } while (0)
+#define boot_page_write_safe(address)	do { boot_spm_busy_wait(); boot_page_write(address); } while (0)
+#define boot_rww_enable_safe()		do { boot_spm_busy_wait(); boot_rww_enable(); } while (0)
+
+#endif /* __hostsim_avr_boot_h_included__ */
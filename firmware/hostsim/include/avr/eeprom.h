@@ -0,0 +1,51 @@
+/* Name: eeprom.h
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Host replacement of <avr/eeprom.h>, built on top of the modelled
+ * EECR/EEAR/EEDR registers (so both the avr-libc style calls and direct
+ * register programming go through the same timing model).
+ */
+
+#ifndef __hostsim_avr_eeprom_h_included__
+#define __hostsim_avr_eeprom_h_included__
+
+#include <stdint.h>
+#include <avr/io.h>
+
+#define EEMEM
+
+#define eeprom_is_ready()		bit_is_clear(EECR, EEPE)
+#define eeprom_busy_wait()		do { } while (!eeprom_is_ready())
+
+static inline uint8_t eeprom_read_byte(const uint8_t *p)
+{
+	eeprom_busy_wait();
+	EEAR = (uint16_t)(uintptr_t)p;
+	EECR |= _BV(EERE);
+	return EEDR;
+}
+
+static inline void eeprom_write_byte(uint8_t *p, uint8_t value)
+{
+	eeprom_busy_wait();
+#if HOSTSIM_HAVE_EEPM
+	EECR &= ~(_BV(EEPM1) | _BV(EEPM0));
+#endif
+	EEAR = (uint16_t)(uintptr_t)p;
+	EEDR = value;
+	EECR |= _BV(EEMPE);
+	EECR |= _BV(EEPE);
+}
+
+static inline void eeprom_update_byte(uint8_t *p, uint8_t value)
+{
+	if (eeprom_read_byte(p) != value)
+		eeprom_write_byte(p, value);
+}
+
+#endif /* __hostsim_avr_eeprom_h_included__ */
@@ -0,0 +1,35 @@
+/* Name: interrupt.h
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Host replacement of <avr/interrupt.h>: the global interrupt flag is
+ * kept in the modelled SREG, interrupt handlers become plain functions
+ * which the simulation model calls whenever their condition is met.
+ */
+
+#ifndef __hostsim_avr_interrupt_h_included__
+#define __hostsim_avr_interrupt_h_included__
+
+#include <avr/io.h>
+
+extern void hostsim_cli(void);
+extern void hostsim_sei(void);
+
+#define cli()				hostsim_cli()
+#define sei()				hostsim_sei()
+
+#define ISR_BLOCK
+#define ISR_NOBLOCK
+#define ISR_NAKED
+#define ISR(vector, ...)		void vector(void); void vector(void)
+
+#define INT0_vect			hostsim_vector_INT0
+#define USART_UDRE_vect			hostsim_vector_USART_UDRE
+#define USART0_UDRE_vect		hostsim_vector_USART_UDRE
+#define TIMER1_OVF_vect			hostsim_vector_TIMER1_OVF
+
+#endif /* __hostsim_avr_interrupt_h_included__ */
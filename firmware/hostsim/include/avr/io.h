@@ -0,0 +1,202 @@
+/* Name: io.h
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Host replacement of <avr/io.h> for the hostsim build.
+ *
+ * The I/O space is modelled as one byte array which is indexed with the
+ * real (ATmega328P/ATmega2560 style) data memory addresses. This keeps
+ * pointer arithmetic like "&PORTD - 2" (used by usbdrv.h) working.
+ * Registers with side effects (EEPROM, timer 1) are routed through
+ * accessor functions of the simulation model instead.
+ *
+ * The memory geometry is selected by HOSTSIM_DEVICE_<device>, which
+ * is derived from DEVICE in Makefile.inc. Supported are atmega8,
+ * atmega88(p), atmega168(p), atmega328(p), atmega644p, atmega1284p and
+ * atmega2560; the ATmega8 has no EEPROM programming modes (EEPM bits).
+ */
+
+#ifndef __hostsim_avr_io_h_included__
+#define __hostsim_avr_io_h_included__
+
+#include <stdint.h>
+
+#if   defined(HOSTSIM_DEVICE_atmega8)
+#	define __AVR_ATmega8__		1
+#	define HOSTSIM_DEVICE		"atmega8"
+#	define FLASHEND			0x1fff
+#	define SPM_PAGESIZE		64
+#	define E2END			0x1ff
+#	define RAMEND			0x45f
+#	define HOSTSIM_HAVE_EEPM	0
+#elif defined(HOSTSIM_DEVICE_atmega88) || defined(HOSTSIM_DEVICE_atmega88p)
+#	define __AVR_ATmega88__		1
+#	define HOSTSIM_DEVICE		"atmega88"
+#	define FLASHEND			0x1fff
+#	define SPM_PAGESIZE		64
+#	define E2END			0x1ff
+#	define RAMEND			0x4ff
+#elif defined(HOSTSIM_DEVICE_atmega168) || defined(HOSTSIM_DEVICE_atmega168p)
+#	define __AVR_ATmega168__	1
+#	define HOSTSIM_DEVICE		"atmega168"
+#	define FLASHEND			0x3fff
+#	define SPM_PAGESIZE		128
+#	define E2END			0x1ff
+#	define RAMEND			0x4ff
+#elif defined(HOSTSIM_DEVICE_atmega644p)
+#	define __AVR_ATmega644P__	1
+#	define HOSTSIM_DEVICE		"atmega644p"
+#	define FLASHEND			0xffff
+#	define SPM_PAGESIZE		256
+#	define E2END			0x7ff
+#	define RAMEND			0x10ff
+#elif defined(HOSTSIM_DEVICE_atmega1284p)
+#	define __AVR_ATmega1284P__	1
+#	define HOSTSIM_DEVICE		"atmega1284p"
+#	define FLASHEND			0x1ffff
+#	define SPM_PAGESIZE		256
+#	define E2END			0xfff
+#	define RAMEND			0x40ff
+#elif defined(HOSTSIM_DEVICE_atmega2560)
+#	define __AVR_ATmega2560__	1
+#	define HOSTSIM_DEVICE		"atmega2560"
+#	define FLASHEND			0x3ffff
+#	define SPM_PAGESIZE		256
+#	define E2END			0xfff
+#	define RAMEND			0x21ff
+#elif defined(HOSTSIM_DEVICE_atmega328) || defined(HOSTSIM_DEVICE_atmega328p)
+#	define __AVR_ATmega328P__	1
+#	define HOSTSIM_DEVICE		"atmega328p"
+#	define FLASHEND			0x7fff
+#	define SPM_PAGESIZE		128
+#	define E2END			0x3ff
+#	define RAMEND			0x8ff
+#else
+#	error "hostsim: unsupported DEVICE, use atmega8, atmega88(p), atmega168(p), atmega328(p), atmega644p, atmega1284p or atmega2560"
+#endif
+
+#ifndef HOSTSIM_HAVE_EEPM
+#	define HOSTSIM_HAVE_EEPM	1
+#endif
+
+#define HOSTSIM_IOSIZE			0x200
+
+extern volatile uint8_t			hostsim_io[HOSTSIM_IOSIZE];
+extern volatile uint8_t			*hostsim_ioreg(uint16_t addr);
+
+#define _SFR_MEM8(addr)			(hostsim_io[(addr)])
+#define _SFR_MEM16(addr)		(*(volatile uint16_t *)&hostsim_io[(addr)])
+#define _SFR_IO8(addr)			_SFR_MEM8((addr) + 0x20)
+#define _SFR_IO_ADDR(sfr)		((uint16_t)(&(sfr) - &hostsim_io[0x20]))
+#define _SFR_MEM_ADDR(sfr)		((uint16_t)(&(sfr) - &hostsim_io[0]))
+
+#define _BV(bit)			(1 << (bit))
+#define bit_is_set(sfr, bit)		((sfr) & _BV(bit))
+#define bit_is_clear(sfr, bit)		(!((sfr) & _BV(bit)))
+#define loop_until_bit_is_set(sfr, bit)	do { } while (bit_is_clear(sfr, bit))
+#define loop_until_bit_is_clear(sfr, bit) do { } while (bit_is_set(sfr, bit))
+
+/* ports */
+#define PINB		_SFR_MEM8(0x23)
+#define DDRB		_SFR_MEM8(0x24)
+#define PORTB		_SFR_MEM8(0x25)
+#define PINC		_SFR_MEM8(0x26)
+#define DDRC		_SFR_MEM8(0x27)
+#define PORTC		_SFR_MEM8(0x28)
+#define PIND		_SFR_MEM8(0x29)
+#define DDRD		_SFR_MEM8(0x2a)
+#define PORTD		_SFR_MEM8(0x2b)
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PB6 6
+#define PB7 7
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+#define PC6 6
+#define PC7 7
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+/* timer 1 */
+#define TIFR1		_SFR_MEM8(0x36)
+#define TOV1		0
+#define TCCR1A		_SFR_MEM8(0x80)
+#define TCCR1B		_SFR_MEM8(0x81)
+#define CS10		0
+#define CS11		1
+#define CS12		2
+#define TCNT1		(*(volatile uint16_t *)hostsim_ioreg(0x84))
+
+/* external interrupts */
+#define EIFR		_SFR_MEM8(0x3c)
+#define INTF0		0
+#define EIMSK		_SFR_MEM8(0x3d)
+#define INT0		0
+#define EICRA		_SFR_MEM8(0x69)
+#define ISC00		0
+#define ISC01		1
+
+/* EEPROM */
+#define EECR		(*hostsim_ioreg(0x3f))
+#define EERE		0
+#define EEPE		1
+#define EEMPE		2
+#define EERIE		3
+#if HOSTSIM_HAVE_EEPM
+#	define EEPM0	4
+#	define EEPM1	5
+#endif
+#define EEDR		(*hostsim_ioreg(0x40))
+#define EEARL		(*hostsim_ioreg(0x41))
+#define EEARH		(*hostsim_ioreg(0x42))
+#define EEAR		(*(volatile uint16_t *)hostsim_ioreg(0x41))
+
+/* reset, system control and self programming */
+#define GPIOR0		_SFR_MEM8(0x3e)
+#define MCUSR		_SFR_MEM8(0x54)
+#define PORF		0
+#define EXTRF		1
+#define BORF		2
+#define WDRF		3
+#define MCUCR		_SFR_MEM8(0x55)
+#define IVCE		0
+#define IVSEL		1
+#define SPMCSR		_SFR_MEM8(0x57)
+#define SPMEN		0
+#define SELFPRGEN	SPMEN
+#define PGERS		1
+#define PGWRT		2
+#define BLBSET		3
+#define RWWSRE		4
+#define SIGRD		5
+#define RWWSB		6
+#define SPMIE		7
+#if (FLASHEND) > 0xffff
+#	define RAMPZ	_SFR_MEM8(0x5b)
+#endif
+#if (FLASHEND) > 0x1ffff
+#	define EIND	_SFR_MEM8(0x5c)
+#endif
+#define SREG		_SFR_MEM8(0x5f)
+#define WDTCSR		_SFR_MEM8(0x60)
+
+#endif /* __hostsim_avr_io_h_included__ */
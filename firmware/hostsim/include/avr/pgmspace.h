@@ -0,0 +1,39 @@
+/* Name: pgmspace.h
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Host replacement of <avr/pgmspace.h>.
+ *
+ * Program memory reads are answered by the flash model. Since the
+ * driver also places its descriptors in "PROGMEM" (which is ordinary
+ * host memory here), addresses beyond the simulated flash are treated
+ * as host pointers. The hostsim build links non-PIE, so host data lives
+ * far above any AVR flash address.
+ */
+
+#ifndef __hostsim_avr_pgmspace_h_included__
+#define __hostsim_avr_pgmspace_h_included__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <avr/io.h>
+
+#define PROGMEM
+#define PSTR(s)				(s)
+
+typedef uint32_t			uint_farptr_t;
+
+extern uint8_t	hostsim_pgm_read_byte(uintptr_t addr);
+
+#define pgm_read_byte(addr)		hostsim_pgm_read_byte((uintptr_t)(addr))
+#define pgm_read_byte_near(addr)	pgm_read_byte(addr)
+#define pgm_read_byte_far(addr)		pgm_read_byte(addr)
+#define pgm_read_word(addr)		((uint16_t)(pgm_read_byte(addr) | (pgm_read_byte((uintptr_t)(addr) + 1) << 8)))
+#define pgm_read_word_near(addr)	pgm_read_word(addr)
+#define pgm_read_word_far(addr)		pgm_read_word(addr)
+
+#endif /* __hostsim_avr_pgmspace_h_included__ */
@@ -0,0 +1,19 @@
+/* Name: wdt.h
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+#ifndef __hostsim_avr_wdt_h_included__
+#define __hostsim_avr_wdt_h_included__
+
+#define WDTO_15MS			0
+#define WDTO_250MS			4
+#define WDTO_1S				6
+
+#define wdt_reset()			do { } while (0)
+#define wdt_disable()			do { } while (0)
+#define wdt_enable(timeout)		do { (void)(timeout); } while (0)
+
+#endif /* __hostsim_avr_wdt_h_included__ */
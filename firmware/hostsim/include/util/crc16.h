@@ -0,0 +1,35 @@
+/* Name: crc16.h
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Host replacement of <util/crc16.h>, C versions of the avr-libc
+ * reference implementations.
+ */
+
+#ifndef __hostsim_util_crc16_h_included__
+#define __hostsim_util_crc16_h_included__
+
+#include <stdint.h>
+
+static inline uint16_t _crc16_update(uint16_t crc, uint8_t a)
+{
+	int i;
+
+	crc ^= a;
+	for (i = 0; i < 8; ++i)
+		crc = (crc & 1) ? ((crc >> 1) ^ 0xa001) : (crc >> 1);
+	return crc;
+}
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+	data ^= (uint8_t)crc;
+	data ^= data << 4;
+	return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+#endif /* __hostsim_util_crc16_h_included__ */
@@ -0,0 +1,21 @@
+/* Name: delay.h
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Host replacement of <util/delay.h>: busy waits only advance the
+ * simulated cycle counter.
+ */
+
+#ifndef __hostsim_util_delay_h_included__
+#define __hostsim_util_delay_h_included__
+
+extern void	hostsim_delay_cycles(double cycles);
+
+#define _delay_ms(ms)			hostsim_delay_cycles((double)(ms) * ((double)(F_CPU) / 1e3))
+#define _delay_us(us)			hostsim_delay_cycles((double)(us) * ((double)(F_CPU) / 1e6))
+
+#endif /* __hostsim_util_delay_h_included__ */
@@ -0,0 +1,266 @@
+/* Name: model.c
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Device model of the hostsim build: flash with temporary page buffer,
+ * RWW blocking and SPM timing, EEPROM with EEPM programming modes and
+ * timer 1. Everything is driven by one simulated cycle counter.
+ *
+ * Misuse which the real silicon would silently ignore or corrupt (SPM
+ * while SPM or EEPROM are busy, reading the RWW section while it is
+ * blocked, ...) is counted, so the driver can flag it.
+ */
+
+#include <stdint.h>
+#include <string.h>
+
+#include "hostsim.h"
+
+volatile uint8_t	hostsim_io[HOSTSIM_IOSIZE];
+
+uint64_t		hostsim_now;
+uint8_t			hostsim_flash[HOSTSIM_FLASHSIZE];
+uint8_t			hostsim_eeprom[HOSTSIM_EEPROMSIZE];
+hostsim_stats_t		hostsim_stats;
+hostsim_timing_t	hostsim_timing = {
+	.erase_us	= 4100,
+	.write_us	= 4100,
+	.ee_atomic_us	= 3400,
+	.ee_erase_us	= 1800,
+	.ee_write_us	= 1800,
+};
+
+static uint16_t		tempBuffer[SPM_PAGESIZE / 2];
+static uint64_t		spmBusyUntil;
+static uint8_t		rwwBlocked;
+static uint64_t		eeBusyUntil;
+static uint8_t		eeActive;
+static uint64_t		timer1Last;
+
+int32_t		hostsim_weak_page = -1;	/* page which gets bit 0 of its first byte flipped */
+
+#define US2CYCLES(us)	((uint64_t)(us) * (uint64_t)((F_CPU) / 1000000UL))
+
+void hostsim_reset(void)
+{
+	memset((void *)hostsim_io, 0, sizeof(hostsim_io));
+	memset(hostsim_flash, 0xff, sizeof(hostsim_flash));
+	memset(hostsim_eeprom, 0xff, sizeof(hostsim_eeprom));
+	memset(tempBuffer, 0xff, sizeof(tempBuffer));
+	memset(&hostsim_stats, 0, sizeof(hostsim_stats));
+	hostsim_now	= 0;
+	spmBusyUntil	= 0;
+	rwwBlocked	= 0;
+	eeBusyUntil	= 0;
+	eeActive	= 0;
+	timer1Last	= 0;
+}
+
+void hostsim_delay_cycles(double cycles)
+{
+	if (cycles > 0)
+		hostsim_now += (uint64_t)cycles;
+	hostsim_tick();
+}
+
+void hostsim_cli(void)
+{
+	SREG &= ~0x80;
+}
+
+void hostsim_sei(void)
+{
+	SREG |= 0x80;
+	hostsim_tick();
+}
+
+/* ------------------------------------------------------------------------ */
+
+static uint8_t eepromBusy(void)
+{
+	return eeActive && (hostsim_now < eeBusyUntil);
+}
+
+uint8_t hostsim_spm_busy(void)
+{
+	hostsim_now += 3;	/* in, sbrc, rjmp of the polling loop */
+	hostsim_tick();
+	return hostsim_now < spmBusyUntil;
+}
+
+uint8_t hostsim_rww_busy(void)
+{
+	return rwwBlocked;
+}
+
+void hostsim_spm(uint8_t spmcsr, uint32_t address, uint16_t data)
+{
+	uint32_t page = address / SPM_PAGESIZE;
+	uint32_t base = page * SPM_PAGESIZE;
+	uint16_t i;
+
+	hostsim_now += 4;
+	if (hostsim_now < spmBusyUntil || eepromBusy()) {
+		/* the real SPM instruction is simply not executed */
+		hostsim_stats.spm_violations++;
+		return;
+	}
+	if ((SREG & 0x80) && (spmcsr & (_BV(PGERS) | _BV(PGWRT))))
+		hostsim_stats.spm_with_interrupts++;
+
+	switch (spmcsr & ~_BV(SPMEN)) {
+	case 0:		/* page buffer fill */
+		tempBuffer[(address % SPM_PAGESIZE) / 2] = data;
+		hostsim_stats.fills++;
+		break;
+	case _BV(PGERS):
+		if (base >= HOSTSIM_FLASHSIZE)
+			break;
+		memset(&hostsim_flash[base], 0xff, SPM_PAGESIZE);
+		hostsim_stats.page_erases[page]++;
+		hostsim_stats.erases++;
+		spmBusyUntil = hostsim_now + US2CYCLES(hostsim_timing.erase_us);
+		hostsim_stats.spm_cycles += US2CYCLES(hostsim_timing.erase_us);
+		if (base < HOSTSIM_NRWW_START)
+			rwwBlocked = 1;
+		break;
+	case _BV(PGWRT):
+		if (base >= HOSTSIM_FLASHSIZE)
+			break;
+		/* programming can only clear bits, erasing sets them */
+		for (i = 0; i < SPM_PAGESIZE / 2; i++) {
+			hostsim_flash[base + 2*i + 0] &= (uint8_t)(tempBuffer[i] >> 0);
+			hostsim_flash[base + 2*i + 1] &= (uint8_t)(tempBuffer[i] >> 8);
+		}
+		if ((int32_t)page == hostsim_weak_page)
+			hostsim_flash[base] ^= 1;
+		memset(tempBuffer, 0xff, sizeof(tempBuffer));
+		hostsim_stats.page_writes[page]++;
+		hostsim_stats.writes++;
+		spmBusyUntil = hostsim_now + US2CYCLES(hostsim_timing.write_us);
+		hostsim_stats.spm_cycles += US2CYCLES(hostsim_timing.write_us);
+		if (base < HOSTSIM_NRWW_START)
+			rwwBlocked = 1;
+		break;
+	case _BV(RWWSRE):
+		rwwBlocked = 0;
+		break;
+	default:
+		break;
+	}
+}
+
+uint8_t hostsim_pgm_read_byte(uintptr_t addr)
+{
+	hostsim_now += 3;
+	if (addr >= HOSTSIM_FLASHSIZE)
+		return *(const uint8_t *)addr;	/* PROGMEM object of the host */
+	if (rwwBlocked && (addr < HOSTSIM_NRWW_START)) {
+		hostsim_stats.rww_read_violations++;
+		return 0xff;
+	}
+	return hostsim_flash[addr];
+}
+
+uint8_t hostsim_fuse(uint16_t which)
+{
+	switch (which) {
+	case GET_LOW_FUSE_BITS:		return 0xd7;
+	case GET_HIGH_FUSE_BITS:	return 0xd0;
+	case GET_EXTENDED_FUSE_BITS:	return 0x04;
+	default:			return 0x3f;
+	}
+}
+
+/* ------------------------------------------------------------------------ */
+
+static void eepromUpdate(void)
+{
+	volatile uint8_t *eecr = &hostsim_io[0x3f];
+	uint16_t	 addr = (hostsim_io[0x41] | (hostsim_io[0x42] << 8)) % HOSTSIM_EEPROMSIZE;
+	uint64_t	 duration;
+	uint8_t		 mode = 0;	/* erase and write, the only mode without EEPM bits */
+
+	if (eeActive && (hostsim_now >= eeBusyUntil)) {
+		eeActive = 0;
+		*eecr &= ~_BV(EEPE);
+	}
+	if ((*eecr & _BV(EEPE)) && !eeActive) {
+		if (hostsim_now < spmBusyUntil)
+			hostsim_stats.ee_violations++;
+#if HOSTSIM_HAVE_EEPM
+		mode = *eecr & (_BV(EEPM1) | _BV(EEPM0));
+#endif
+		switch (mode) {
+#if HOSTSIM_HAVE_EEPM
+		case _BV(EEPM0):	/* erase only */
+			hostsim_eeprom[addr] = 0xff;
+			duration = hostsim_timing.ee_erase_us;
+			hostsim_stats.ee_erase_ops++;
+			break;
+		case _BV(EEPM1):	/* write only */
+			hostsim_eeprom[addr] &= hostsim_io[0x40];
+			duration = hostsim_timing.ee_write_us;
+			hostsim_stats.ee_write_ops++;
+			break;
+#endif
+		default:		/* erase and write */
+			hostsim_eeprom[addr] = hostsim_io[0x40];
+			duration = hostsim_timing.ee_atomic_us;
+			hostsim_stats.ee_atomic_ops++;
+			break;
+		}
+		eeActive	= 1;
+		eeBusyUntil	= hostsim_now + US2CYCLES(duration);
+		hostsim_stats.ee_cycles += US2CYCLES(duration);
+		*eecr &= ~_BV(EEMPE);
+	}
+	if (*eecr & _BV(EERE)) {
+		hostsim_io[0x40] = hostsim_eeprom[addr];
+		*eecr &= ~_BV(EERE);
+	}
+}
+
+static void timer1Update(void)
+{
+	static const uint16_t prescale[8] = { 0, 1, 8, 64, 256, 1024, 0, 0 };
+	uint16_t	div = prescale[hostsim_io[0x81] & 7];
+	uint16_t	tcnt;
+	uint64_t	ticks;
+
+	if (!div) {
+		timer1Last = hostsim_now;
+		return;
+	}
+	ticks = (hostsim_now - timer1Last) / div;
+	timer1Last += ticks * div;
+	tcnt = (hostsim_io[0x84] | (hostsim_io[0x85] << 8));
+	if (tcnt + ticks > 0xffff)
+		hostsim_io[0x36] |= _BV(TOV1);
+	tcnt += (uint16_t)ticks;
+	hostsim_io[0x84] = (uint8_t)tcnt;
+	hostsim_io[0x85] = (uint8_t)(tcnt >> 8);
+}
+
+volatile uint8_t *hostsim_ioreg(uint16_t addr)
+{
+	hostsim_now += 1;
+	hostsim_tick();
+	return &hostsim_io[addr];
+}
+
+void hostsim_tick(void)
+{
+	static uint8_t inTick;
+
+	if (inTick)
+		return;
+	inTick = 1;
+	eepromUpdate();
+	timer1Update();
+	inTick = 0;
+}
@@ -0,0 +1,38 @@
+/* Name: usbemu.h
+ * Project: USBaspLoader (hostsim)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Interface between the hostsim driver (playing the host) and the boot
+ * loader translation unit (playing the device including its USB ISR).
+ */
+
+#ifndef __usbemu_h_included__
+#define __usbemu_h_included__
+
+#include <stdint.h>
+
+#define USBEMU_ACK		0
+#define USBEMU_NAK		1
+#define USBEMU_STALL		2
+
+#define USBEMU_PID_SETUP	0x2d
+#define USBEMU_PID_OUT		0xe1
+
+/* token (and data stage) of one transaction as seen by the device ISR */
+extern int	usbemu_setup_or_out(uint8_t token, const uint8_t *data, uint8_t len);
+extern int	usbemu_in(uint8_t *data, uint8_t *len);
+
+/* main() from a reset with MCUSR = resetFlags up to its main loop */
+extern void	hostsim_bl_start(uint8_t resetFlags);
+extern void	hostsim_bl_poll(void);
+
+/* cycle at which the device attached to the bus (after the fake disconnect) */
+extern uint64_t	hostsim_bl_attached;
+/* cycle at which the boot loader jumped to the application, 0 before */
+extern uint64_t	hostsim_bl_left;
+
+#endif /* __usbemu_h_included__ */
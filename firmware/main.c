@@ -18,6 +18,7 @@
 #include <avr/boot.h>
 #include <avr/eeprom.h>
 #include <util/delay.h>
+#include <util/crc16.h>
 
 
 #if 0
@@ -38,6 +39,7 @@
 #include <avr/boot.h>
 
 #include <string.h>
+#include <stddef.h>
 
 
 
@@ -75,6 +77,17 @@
 #define USBASP_FUNC_TPI_READBLOCK    15
 #define USBASP_FUNC_TPI_WRITEBLOCK   16
 #define USBASP_FUNC_GETCAPABILITIES 127
+
+// extensions of this boot loader
+#define USBASP_FUNC_GETVERIFYSTATUS  64
+#define USBASP_FUNC_GETFLASHCRC      65
+#define USBASP_FUNC_GETEEPROMCRC     66
+#define USBASP_FUNC_GETPAGECRCS      67
+#define USBASP_FUNC_WRITEFLASHLZ     68
+#define USBASP_FUNC_TRANSMITBATCH    69
+#define USBASP_FUNC_GETBATCHRESULTS  70
+#define USBASP_FUNC_GETTRACE         71
+#define USBASP_FUNC_GETSTATS         72
 /* ------------------------------------------------------------------------ */
 
 #ifndef ulong
@@ -109,6 +122,17 @@
 #   define addr_t           uint
 #endif
 
+/* The per byte loops work on the 16 bit offset currentAddress.w[0] and
+ * only carry into the upper word when it wraps at a 64 k boundary.
+ */
+#if (FLASHEND) > 0xffff
+#   define ADVANCE_ADDRESS(n)       do{ if((currentAddress.w[0] += (n)) < (n)) currentAddress.w[1]++; }while(0)
+#   define FLASH_READ(page, offset) pgm_read_byte_far(((ulong)(page) << 16) | (offset))
+#else
+#   define ADVANCE_ADDRESS(n)       (currentAddress.w[0] += (n))
+#   define FLASH_READ(page, offset) pgm_read_byte(offset)
+#endif
+
 typedef union longConverter{
     addr_t  l;
     uint    w[sizeof(addr_t)/2];
@@ -117,7 +141,8 @@ typedef union longConverter{
 
 
 #if EXIT_AFTER_UPLOAD
-static volatile unsigned char   requestExit = 0;
+static volatile unsigned char   requestExit = 0;	/* token ending USBASP_FUNC_DISCONNECT, see exitDue() */
+static uint                     exitTimeout;
   #if BOOTLOADER_CAN_EXIT
 static volatile unsigned char	stayInLoader = 0xfe;
   #endif
@@ -125,13 +150,209 @@ static volatile unsigned char	stayInLoader = 0xfe;
 
 
 static longConverter_t  	currentAddress; /* in bytes */
-static uchar            	bytesRemaining;
+static usbMsgLen_t      	bytesRemaining; /* 16 bit with USE_LONG_TRANSFERS */
 static uchar            	isLastPage;
-#if HAVE_EEPROM_PAGED_ACCESS
+#if (HAVE_EEPROM_PAGED_ACCESS) || (USE_PAGE_DIGESTS) || (USE_LZ_WRITE) || (USE_ISP_BATCH)
 static uchar            	currentRequest;
 #else
 static const uchar      	currentRequest = 0;
 #endif
+#if (USE_ZEROCOPY_READFLASH) && ((FLASHEND) > 0xffff)
+uchar                   	usbMsgFlashPage = USB_CFG_DRIVER_FLASH_PAGE; /* see usbconfig.h */
+#endif
+
+#if (!HAVE_CHIP_ERASE) || (HAVE_ONDEMAND_PAGEERASE)
+#   define ERASE_BEFORE_WRITE	1
+#else
+#   define ERASE_BEFORE_WRITE	0
+#endif
+
+#define HAVE_PAGEBUFFER		((USE_PAGE_PIPELINE) || (USE_PAGE_COMPARE) || (USE_PAGE_ERASE_ELISION) || \
+				 (USE_ERASED_PAGEMAP) || (USE_BACKGROUND_CHIPERASE) || (USE_WRITE_VERIFY) || \
+				 (USE_LZ_WRITE))
+#define HAVE_PAGEANALYSIS	((USE_PAGE_COMPARE) || ((USE_PAGE_ERASE_ELISION) && (ERASE_BEFORE_WRITE)) || (USE_ERASED_PAGEMAP))
+
+#if HAVE_PAGEBUFFER
+/* next SPM operation to be started by pageCommitPoll() */
+#define SPMSTATE_IDLE		0
+#define SPMSTATE_ERASE		1
+#define SPMSTATE_WRITE		2
+#define SPMSTATE_RWWENABLE	3
+#define SPMSTATE_VERIFY		4	/* RWW enable and verify */
+
+/* result of pageAnalyse() */
+#define PAGE_CHANGED		0x01
+#define PAGE_NEEDS_ERASE	0x02
+
+static uchar            	pageBuffer[SPM_PAGESIZE];
+static addr_t           	pageAddress;	/* page held by pageBuffer */
+static uchar            	pagePending;	/* pageBuffer is complete */
+static addr_t           	spmAddress;	/* page currently programmed */
+static uchar            	spmState;
+#if USE_STATS
+static uchar            	spmTimed;	/* SPMSTATE_ERASE/WRITE: operation started at spmStart */
+static uint             	spmStart;	/* timer 1 when it was started */
+#endif
+#endif
+
+#if USE_WRITE_VERIFY
+static uint             	spmCrc;		/* CRC16 of the data handed to SPM */
+
+/* reply of USBASP_FUNC_GETVERIFYSTATUS, little endian */
+static struct {
+    ulong   firstAddress;	/* page of the first verify error */
+    uint    errors;		/* pages failed since USBASP_FUNC_CONNECT */
+} verifyStatus;
+#endif
+
+#define HAVE_TIMER1		((USE_TRACE) || (USE_STATS) || (USE_FAST_ENUMERATION))
+
+#if HAVE_TIMER1
+/* timer 1 runs free at F_CPU/64 while the boot loader is active */
+#define TIMER1_START()		(TCCR1B = (1 << CS11) | (1 << CS10))
+#endif
+
+#if USE_TRACE
+/*
+ * Event trace (see tools/trace.h): the newest TRACE_ENTRIES events with
+ * their timer 1 count. USBASP_FUNC_GETTRACE sends the structure as it
+ * is, "next" tells the host where the oldest entry is. Unused entries
+ * have the event 0xff.
+ */
+#ifndef TRACE_ENTRIES
+#  if (RAMEND) >= 0x08ff
+#    define TRACE_ENTRIES	63
+#  else
+#    define TRACE_ENTRIES	16
+#  endif
+#endif
+#if (TRACE_ENTRIES > 255) || ((!USE_LONG_TRANSFERS) && (2 + 4 * (TRACE_ENTRIES) > 254))
+#  error "TRACE_ENTRIES too large"
+#endif
+
+/* events, the same numbers as the DBG1() calls where there are some */
+#define TRACE_SETUP		0x30	/* data: bRequest */
+#define TRACE_FILL		0x32	/* data of these: page number */
+#define TRACE_ERASE		0x33
+#define TRACE_WRITE		0x34
+#define TRACE_FILLED		0x35
+#define TRACE_RWWENABLE		0x36
+#define TRACE_SKIP		0x37	/* page neither erased nor written */
+
+#define TRACE_PAGE(addr)	((uchar)((addr) / SPM_PAGESIZE))
+
+static struct {
+    uchar   next;
+    uchar   entries;
+    struct {
+        uchar   event;
+        uchar   data;
+        uint    time;
+    } entry[TRACE_ENTRIES];
+} trace;
+
+static void traceEvent(uchar event, uchar data) {
+  uchar i = trace.next;
+
+  trace.entry[i].event = event;
+  trace.entry[i].data = data;
+  trace.entry[i].time = TCNT1;
+  if (++i >= TRACE_ENTRIES) i = 0;
+  trace.next = i;
+}
+
+static void traceClear(void) {
+  memset(&trace, 0xff, sizeof(trace));
+  trace.next = 0;
+  trace.entries = TRACE_ENTRIES;
+}
+#  define TRACE(event, data)	traceEvent((event), (data))
+#else
+#  define TRACE(event, data)
+#endif
+
+#if USE_STATS
+/* reply of USBASP_FUNC_GETSTATS, little endian, times in timer 1 ticks */
+static struct stats {
+    ulong   spmWaitTicks;	/* blocked waiting for SPM */
+    ulong   writeTicks;		/* spent in usbFunctionWrite() */
+    ulong   readTicks;		/* spent in usbFunctionRead() */
+    uint    setups;
+    uint    pagesFilled;	/* copied into the SPM page buffer */
+    uint    pagesErased;
+    uint    pagesWritten;
+    uint    pagesSkipped;	/* neither erased nor written */
+    uint    eepromBytes;	/* EEPROM bytes programmed */
+    uint    eraseTicks;		/* shortest page erase seen, 0xffff if none */
+    uint    pageWriteTicks;	/* shortest page write seen, 0xffff if none */
+} stats = { .eraseTicks = 0xffff, .pageWriteTicks = 0xffff };
+
+/* keeps the shortest time since start in *min */
+static void statsMin(uint *min, uint start) {
+  uint t = TCNT1 - start;
+
+  if (t < *min) *min = t;
+}
+
+/*
+ * Timer 1 extended to 32 bits by counting its wraps. A measurement can
+ * span several wraps (a background chip erase takes seconds) as long as
+ * this runs at least once per 65536 ticks meanwhile, which
+ * pageCommitPoll() does in every wait loop.
+ */
+static uint statsLast, statsHigh;
+
+static ulong statsNow(void) {
+  uint t = TCNT1;
+
+  if (t < statsLast) statsHigh++;
+  statsLast = t;
+  return ((ulong)statsHigh << 16) | t;
+}
+
+/* clears all but the erase and write times, which belong to the chip */
+static void statsClear(void) {
+  memset(&stats, 0, offsetof(struct stats, eraseTicks));
+}
+
+#if !HAVE_PAGEBUFFER
+/* waits for the SPM operation just started and records its duration */
+static void spmWaitTimed(uint *min) {
+  uint start = TCNT1;
+
+  boot_spm_busy_wait();
+  statsMin(min, start);
+  stats.spmWaitTicks += (uint)(TCNT1 - start);
+}
+#endif
+#  define STATS_INC(counter)		(stats.counter++)
+#  define STATS_BEGIN(start)		ulong start = statsNow()
+#  define STATS_END(sum, start)		(stats.sum += statsNow() - (start))
+#  define SPM_BUSY_WAIT(min)		spmWaitTimed(&stats.min)
+#else
+#  define STATS_INC(counter)
+#  define STATS_BEGIN(start)
+#  define STATS_END(sum, start)
+#  define SPM_BUSY_WAIT(min)		boot_spm_busy_wait()
+#endif
+
+#if USE_ERASED_PAGEMAP
+#define FLASH_PAGES		(((FLASHEND) + 1UL) / SPM_PAGESIZE)
+
+/* bit set: page is blank since the last chip erase */
+static uchar            	erasedPages[(FLASH_PAGES + 7) / 8];
+#endif
+
+#if USE_BACKGROUND_CHIPERASE
+#if HAVE_BLB11_SOFTW_LOCKBIT
+#   define CHIPERASE_END	((addr_t)(BOOTLOADER_PAGEADDR))
+#else
+#   define CHIPERASE_END	((addr_t)((FLASHEND) + 1UL))
+#endif
+
+static addr_t           	chipEraseAddress;	/* next page to be erased */
+static uchar            	chipEraseRunning;
+#endif
 
 static const uchar  signatureBytes[4] = {
 #ifdef SIGNATURE_BYTES
@@ -230,11 +451,55 @@ void __func_clearram(void) {
 }
 #endif
 
+#if (USE_FAST_APPENTRY)
+#ifndef FAST_APPENTRY_SETTLE
+#  define FAST_APPENTRY_SETTLE	((F_CPU) / 1500000 + 1)	/* loops of 3 cycles, about 2 us */
+#endif
+/*
+ * Runs right after the reset vector, before the stack, .data and .bss
+ * are set up: if main() would leave the boot loader anyway (no external
+ * reset, jumper open), jump to the application here. The pull-up gets
+ * FAST_APPENTRY_SETTLE loops before the pin is sampled; if that is too
+ * short, the pin reads low and main() decides as before. This is
+ * bootLoaderInit() and bootLoaderCondition() of bootloaderconfig.h in
+ * assembler, change them together.
+ */
+void __attribute__ ((section(".init1"),naked,used,no_instrument_function)) __func_fastappentry(void);
+void __func_fastappentry(void) {
+  asm volatile (
+    "in r24, %[mcusr]\n\t"
+    "sbrs r24, %[extrf]\n\t"
+    "rjmp __fastappentry_app%=\n\t"
+    "sbi %[port], %[bit]\n\t"
+    "ldi r24, %[settle]\n\t"
+    "__fastappentry_settle%=:\n\t"
+    "dec r24\n\t"
+    "brne __fastappentry_settle%=\n\t"
+    "sbis %[pin], %[bit]\n\t"
+    "rjmp __fastappentry_loader%=\n\t"
+    "cbi %[port], %[bit]\n\t"
+    "__fastappentry_app%=:\n\t"
+    "clr r30\n\t"
+    "clr r31\n\t"
+    "ijmp\n\t"
+    "__fastappentry_loader%=:\n\t"
+    :
+    : [mcusr] "I" (_SFR_IO_ADDR(MCUCSR)),
+      [extrf] "I" (EXTRF),
+      [port] "I" (_SFR_IO_ADDR(PIN_PORT(JUMPER_PORT))),
+      [pin] "I" (_SFR_IO_ADDR(PIN_PIN(JUMPER_PORT))),
+      [bit] "I" (JUMPER_BIT),
+      [settle] "M" (FAST_APPENTRY_SETTLE)
+      );
+}
+#endif
+
 static void (*nullVector)(void) __attribute__((__noreturn__));
 
 static void __attribute__((__noreturn__)) leaveBootloader(void);
 static void leaveBootloader(void) {
     DBG1(0x01, 0, 0);
+    odDebugFlush();
     cli();
     usbDeviceDisconnect();
     bootLoaderExit();
@@ -242,6 +507,10 @@ static void leaveBootloader(void) {
     USB_INTR_CFG = 0;       /* also reset config bits */
     GICR = (1 << IVCE);     /* enable change of interrupt vectors */
     GICR = (0 << IVSEL);    /* move interrupts to application flash section */
+#if HAVE_TIMER1
+    TCCR1B = 0;             /* leave timer 1 as after reset */
+    TCNT1 = 0;
+#endif
 
 /*
  * There seems to be another funny compiler Bug.
@@ -262,6 +531,575 @@ static void leaveBootloader(void) {
 
 /* ------------------------------------------------------------------------ */
 
+#if USE_ASM_PAGEFILL
+/*
+ * Hand-optimized replacement for the cli/boot_page_fill/sei loop:
+ * copies len bytes (2, 4, 6 or 8) from data into the SPM page buffer
+ * at addr. Only the page offset of addr matters (the page buffer ignores
+ * RAMPZ), so 16 bits are enough on any device and Z is simply counted
+ * up. All bytes are loaded into registers beforehand, so interrupts
+ * are only disabled around the movw/sts/spm sequences, two words at a
+ * time: 16 cycles, where four words would take 30 and exceed the 25
+ * cycles the USB interrupt may be held off at any clock (see "Interrupt
+ * latency" in usbdrv.h).
+ * The data must not cross a page boundary.
+ */
+static void pageFill(uint addr, const uchar *data, uchar len) {
+  asm volatile (
+    "ld		r18,	%a[data]+		\n\t"
+    "ld		r19,	%a[data]+		\n\t"
+    "ld		r20,	%a[data]+		\n\t"
+    "ld		r21,	%a[data]+		\n\t"
+    "ld		r22,	%a[data]+		\n\t"
+    "ld		r23,	%a[data]+		\n\t"
+    "ld		r24,	%a[data]+		\n\t"
+    "ld		r25,	%a[data]+		\n\t"
+    "lsr	%[len]				\n\t"	/* words */
+    "cli					\n\t"
+    "movw	r0,	r18			\n\t"
+    "sts	%[spmreg],	%[spmen]	\n\t"
+    "spm					\n\t"
+    "dec	%[len]				\n\t"
+    "breq	pageFill_done%=			\n\t"
+    "adiw	r30,	2			\n\t"
+    "movw	r0,	r20			\n\t"
+    "sts	%[spmreg],	%[spmen]	\n\t"
+    "spm					\n\t"
+    "dec	%[len]				\n\t"
+    "breq	pageFill_done%=			\n\t"
+    "sei					\n\t"	/* USB may interrupt after the adiw */
+    "adiw	r30,	2			\n\t"
+    "cli					\n\t"
+    "movw	r0,	r22			\n\t"
+    "sts	%[spmreg],	%[spmen]	\n\t"
+    "spm					\n\t"
+    "dec	%[len]				\n\t"
+    "breq	pageFill_done%=			\n\t"
+    "adiw	r30,	2			\n\t"
+    "movw	r0,	r24			\n\t"
+    "sts	%[spmreg],	%[spmen]	\n\t"
+    "spm					\n\t"
+"pageFill_done%=:				\n\t"
+    "sei					\n\t"
+    "clr	__zero_reg__			\n\t"
+    : [len] "+r" (len),
+      [data] "+x" (data),
+      [addr] "+z" (addr)
+    : [spmreg] "i" (_SFR_MEM_ADDR(__SPM_REG)),
+      [spmen] "r" ((uchar)__BOOT_PAGE_FILL)
+    : "r0", "r18", "r19", "r20", "r21", "r22", "r23", "r24", "r25", "memory"
+  );
+}
+#endif
+
+/* ------------------------------------------------------------------------ */
+
+#if HAVE_PAGEANALYSIS
+/*
+ * Compares pageBuffer with the flash page at spmAddress, just like
+ * mypgm_WRITEpage() of the updater does. Returns PAGE_CHANGED if the
+ * contents differ and PAGE_NEEDS_ERASE if some bit has to go from 0
+ * to 1 (which only an erase can do). SPM must be idle.
+ */
+static uchar pageAnalyse(void) {
+  uchar i = 0;
+#if (USE_PAGE_COMPARE) || (USE_PAGE_ERASE_ELISION)
+  uchar flash, result = 0;
+#endif
+
+#if USE_ERASED_PAGEMAP
+  {
+    uint page = spmAddress / SPM_PAGESIZE;
+
+    if (erasedPages[page >> 3] & (1 << (page & 7))) {
+      /* page is blank: no erase and nothing to do for 0xff data */
+      do {
+	if (pageBuffer[i] != 0xff) return PAGE_CHANGED;
+	i++;
+      } while (i != (uchar)SPM_PAGESIZE);
+      return 0;
+    }
+  }
+#endif
+#if (USE_PAGE_COMPARE) || (USE_PAGE_ERASE_ELISION)
+  /* a chip erase leaves the RWW section disabled */
+  if (boot_rww_busy()) {
+    cli();
+    boot_rww_enable();
+    sei();
+  }
+  do {
+#if ((FLASHEND) > 65535)
+    flash = pgm_read_byte_far(spmAddress + i);
+#else
+    flash = pgm_read_byte(spmAddress + i);
+#endif
+    if (flash != pageBuffer[i]) result = PAGE_CHANGED;
+#if USE_PAGE_ERASE_ELISION
+    /* flash = x, buffer = y: erase needed if /x * y */
+    if ((uchar)(~flash) & pageBuffer[i]) return PAGE_CHANGED | PAGE_NEEDS_ERASE;
+#endif
+    i++;
+  } while (i != (uchar)SPM_PAGESIZE);
+#if !USE_PAGE_ERASE_ELISION
+  if (result) result |= PAGE_NEEDS_ERASE;
+#endif
+  return result;
+#else
+  return PAGE_CHANGED | PAGE_NEEDS_ERASE;
+#endif
+}
+#endif
+
+#if USE_WRITE_VERIFY
+/*
+ * Compares the page just written with the CRC of the data handed to
+ * SPM and records a mismatch. The RWW section must be readable.
+ */
+static void pageVerify(void) {
+  uint  crc = 0xffff;
+  uchar i = 0;
+
+  do {
+#if ((FLASHEND) > 65535)
+    crc = _crc16_update(crc, pgm_read_byte_far(spmAddress + i));
+#else
+    crc = _crc16_update(crc, pgm_read_byte(spmAddress + i));
+#endif
+    i++;
+  } while (i != (uchar)SPM_PAGESIZE);
+  if (crc != spmCrc) {
+    if (!verifyStatus.errors) verifyStatus.firstAddress = spmAddress;
+    verifyStatus.errors++;
+  }
+}
+#endif
+
+#if HAVE_PAGEBUFFER
+/*
+ * Advances the programming of flash pages by one step and returns
+ * without waiting for the SPM hardware. So it can be called from the
+ * main loop as well as from within usbFunctionWrite().
+ * If SPM is idle, a complete page in pageBuffer is copied into the
+ * SPM page buffer and its erase (or write) is scheduled. Afterwards
+ * pageBuffer is free to receive the next page from USB while the
+ * previous one is still programmed.
+ * With USE_PAGE_COMPARE pages identical to flash are just dropped,
+ * with USE_PAGE_ERASE_ELISION pages which only clear bits are written
+ * without erasing them first. USE_ERASED_PAGEMAP does the same for
+ * pages known to be blank without reading the flash.
+ * A background chip erase (USE_BACKGROUND_CHIPERASE) is advanced by
+ * one page whenever there is nothing else to do.
+ * With USE_WRITE_VERIFY every written page is read back and checked.
+ */
+static void pageCommitPoll(void) {
+  uchar i;
+
+#if USE_STATS
+  statsNow();
+#endif
+  if (boot_spm_busy()) return;
+#if USE_STATS
+  /* the main loop polls often, the shortest time seen is close to the real one */
+  if (spmTimed) {
+    statsMin((spmTimed == SPMSTATE_ERASE) ? &stats.eraseTicks : &stats.pageWriteTicks, spmStart);
+    spmTimed = 0;
+  }
+#endif
+
+  if (spmState == SPMSTATE_ERASE) {
+    DBG1(0x33, 0, 0);
+    TRACE(TRACE_ERASE, TRACE_PAGE(spmAddress));
+    STATS_INC(pagesErased);
+#ifndef NO_FLASH_WRITE
+    cli();
+    boot_page_erase(spmAddress);
+    sei();
+#endif
+#if USE_STATS
+    spmStart = TCNT1;
+    spmTimed = SPMSTATE_ERASE;
+#endif
+    spmState = SPMSTATE_WRITE;
+  } else if (spmState == SPMSTATE_WRITE) {
+    DBG1(0x34, 0, 0);
+    TRACE(TRACE_WRITE, TRACE_PAGE(spmAddress));
+    STATS_INC(pagesWritten);
+#ifndef NO_FLASH_WRITE
+    cli();
+    boot_page_write(spmAddress);
+    sei();
+#endif
+#if USE_STATS
+    spmStart = TCNT1;
+    spmTimed = SPMSTATE_WRITE;
+#endif
+#if USE_ERASED_PAGEMAP
+    {
+      uint page = spmAddress / SPM_PAGESIZE;
+
+      erasedPages[page >> 3] &= ~(1 << (page & 7));
+    }
+#endif
+#if USE_WRITE_VERIFY
+    spmState = SPMSTATE_VERIFY;
+#else
+    spmState = SPMSTATE_RWWENABLE;
+#endif
+  } else if (spmState >= SPMSTATE_RWWENABLE) {
+#ifndef NO_FLASH_WRITE
+    cli();
+    boot_rww_enable();
+    sei();
+#endif
+    TRACE(TRACE_RWWENABLE, TRACE_PAGE(spmAddress));
+#if USE_WRITE_VERIFY
+    if (spmState == SPMSTATE_VERIFY) pageVerify();
+#endif
+    spmState = SPMSTATE_IDLE;
+  } else if (pagePending
+#if USE_BACKGROUND_CHIPERASE
+	     /* a running chip erase must have passed the page */
+	     && !(chipEraseRunning && (pageAddress >= chipEraseAddress))
+#endif
+	    ) {
+    spmAddress = pageAddress;
+#if HAVE_PAGEANALYSIS
+    i = pageAnalyse();
+#endif
+#if (USE_PAGE_COMPARE) || (USE_ERASED_PAGEMAP)
+    /* identical pages (or blank data for blank pages) are neither erased nor written */
+    if (i & PAGE_CHANGED)
+#endif
+    {
+#if (ERASE_BEFORE_WRITE) && (HAVE_PAGEANALYSIS)
+      spmState = (i & PAGE_NEEDS_ERASE) ? SPMSTATE_ERASE : SPMSTATE_WRITE;
+#elif ERASE_BEFORE_WRITE
+      spmState = SPMSTATE_ERASE;
+#else
+      spmState = SPMSTATE_WRITE;
+#endif
+      /* SPM_PAGESIZE may be 256, so let i wrap around... */
+      i = 0;
+#if USE_WRITE_VERIFY
+      spmCrc = 0xffff;
+#endif
+      TRACE(TRACE_FILL, TRACE_PAGE(spmAddress));
+      do {
+#if USE_ASM_PAGEFILL
+	pageFill((uint)spmAddress + i, &pageBuffer[i], 8);
+#  if USE_WRITE_VERIFY
+	{
+	  uchar j;
+
+	  for (j = 0; j < 8; j++) spmCrc = _crc16_update(spmCrc, pageBuffer[i + j]);
+	}
+#  endif
+	i += 8;
+#else
+#  if USE_WRITE_VERIFY
+	spmCrc = _crc16_update(spmCrc, pageBuffer[i]);
+	spmCrc = _crc16_update(spmCrc, pageBuffer[i+1]);
+#  endif
+	cli();
+	boot_page_fill(spmAddress + i, *(short *)&pageBuffer[i]);
+	sei();
+	i += 2;
+#endif
+      } while (i != (uchar)SPM_PAGESIZE);
+      TRACE(TRACE_FILLED, TRACE_PAGE(spmAddress));
+      STATS_INC(pagesFilled);
+    }
+#if ((USE_TRACE) || (USE_STATS)) && ((USE_PAGE_COMPARE) || (USE_ERASED_PAGEMAP))
+    else {
+      TRACE(TRACE_SKIP, TRACE_PAGE(spmAddress));
+      STATS_INC(pagesSkipped);
+    }
+#endif
+    memset(pageBuffer, 0xff, sizeof(pageBuffer));
+    pagePending = 0;
+#if USE_PAGE_PIPELINE
+    if (usbAllRequestsAreDisabled()) usbEnableAllRequests();
+#endif
+#if USE_BACKGROUND_CHIPERASE
+  } else if (chipEraseRunning) {
+    DBG1(0x33, 0, 0);
+    STATS_INC(pagesErased);
+#ifndef NO_FLASH_WRITE
+    cli();
+    boot_page_erase(chipEraseAddress);
+    sei();
+#endif
+#if USE_STATS
+    spmStart = TCNT1;
+    spmTimed = SPMSTATE_ERASE;
+#endif
+#if USE_ERASED_PAGEMAP
+    {
+      uint page = chipEraseAddress / SPM_PAGESIZE;
+
+      erasedPages[page >> 3] |= (1 << (page & 7));
+    }
+#endif
+    chipEraseAddress += SPM_PAGESIZE;
+    if (chipEraseAddress == CHIPERASE_END) {
+      chipEraseRunning = 0;
+      spmState = SPMSTATE_RWWENABLE;
+    }
+#endif
+  }
+}
+
+/*
+ * Blocks until all received flash data is programmed, a running chip
+ * erase is finished and the RWW section is readable again.
+ */
+static void pageCommitFlush(void) {
+  STATS_BEGIN(start);
+
+  while (pagePending || (spmState != SPMSTATE_IDLE)
+#if USE_BACKGROUND_CHIPERASE
+	 || chipEraseRunning
+#endif
+	) pageCommitPoll();
+  boot_spm_busy_wait();
+  STATS_END(spmWaitTicks, start);
+}
+
+/*
+ * Hands the filled pageBuffer (ending just before currentAddress) over
+ * to pageCommitPoll(), without waiting if pages are pipelined.
+ */
+static void pageBufferCommit(void) {
+  pageAddress = (CURRENT_ADDRESS - 1) & ~(addr_t)(SPM_PAGESIZE - 1);
+  pagePending = 1;
+#if USE_PAGE_PIPELINE
+  pageCommitPoll();
+#else
+  {
+    STATS_BEGIN(start);
+
+    while (pagePending || (spmState != SPMSTATE_IDLE)) pageCommitPoll();
+    STATS_END(spmWaitTicks, start);
+  }
+#endif
+}
+
+/*
+ * Stores one byte at currentAddress in pageBuffer and commits the page
+ * when it is full.
+ */
+static void pageBufferPut(uchar c) {
+  /* previous page did not make it into SPM yet (should be rare) */
+  if (pagePending) {
+    STATS_BEGIN(start);
+
+    while (pagePending) pageCommitPoll();
+    STATS_END(spmWaitTicks, start);
+  }
+  pageBuffer[currentAddress.b[0] & (SPM_PAGESIZE - 1)] = c;
+  ADVANCE_ADDRESS(1);
+  if ((currentAddress.w[0] & (SPM_PAGESIZE - 1)) == 0) pageBufferCommit();
+}
+#endif
+
+#if USE_EEPROM_UPDATE
+/*
+ * Writes one EEPROM byte only if it differs and with the shortest
+ * programming mode the change allows. Waits for a previous write (in
+ * eeprom_read_byte()) but not for this one.
+ */
+static void eepromUpdateByte(uint addr, uchar data) {
+  uchar old = eeprom_read_byte((void *)addr);
+
+  if (old == data) return;
+  STATS_INC(eepromBytes);
+#if defined(EEPM0) && defined(EEPM1)
+  {
+    uchar mode = 0;                     /* erase and write */
+
+    if ((old & data) == data)
+      mode = (1 << EEPM1);              /* only clears bits: write only */
+    else if (data == 0xff)
+      mode = (1 << EEPM0);              /* only sets bits: erase only */
+    EEAR = addr;
+    EEDR = data;
+    EECR = mode;                        /* EEPM can only be changed while EEPE is clear */
+    cli();
+    EECR |= (1 << EEMPE);
+    EECR |= (1 << EEPE);
+    sei();
+  }
+#else
+  eeprom_write_byte((void *)addr, data);
+#endif
+}
+#  define EEPROM_WRITE(addr, data)	eepromUpdateByte((addr), (data))
+#else
+#  define EEPROM_WRITE(addr, data)	do{ STATS_INC(eepromBytes); eeprom_write_byte((void *)(addr), (data)); }while(0)
+#endif
+
+#if USE_EEPROM_QUEUE
+/*
+ * EEPROM write-behind: usbFunctionWrite() only queues the bytes, the
+ * main loop starts one EEPROM write whenever the previous one is done.
+ * USB data is NAKed while there is no room for another packet. Requests
+ * which might read the EEPROM or program the flash drain the queue first,
+ * so SPM never overlaps with an EEPROM write.
+ */
+#define EEQUEUE_SIZE		32	/* power of 2 */
+
+static uint             	eeQueueAddr[EEQUEUE_SIZE];
+static uchar            	eeQueueData[EEQUEUE_SIZE];
+static uchar            	eeQueueHead;	/* next free entry */
+static uchar            	eeQueueTail;	/* oldest entry */
+
+#define EEQUEUE_USED()		((uchar)(eeQueueHead - eeQueueTail) & (EEQUEUE_SIZE - 1))
+#define EEQUEUE_ROOM()		(EEQUEUE_SIZE - 1 - EEQUEUE_USED())
+
+/* starts writing the oldest queued byte if the EEPROM is ready */
+static void eeQueuePoll(void) {
+  uchar t = eeQueueTail;
+
+  if (t == eeQueueHead || !eeprom_is_ready()) return;
+  EEPROM_WRITE(eeQueueAddr[t], eeQueueData[t]);
+  eeQueueTail = (t + 1) & (EEQUEUE_SIZE - 1);
+  if (usbAllRequestsAreDisabled() && EEQUEUE_ROOM() >= 8) usbEnableAllRequests();
+}
+
+static void eeQueuePut(uint addr, uchar data) {
+  uchar h = eeQueueHead;
+
+  while (EEQUEUE_ROOM() == 0) eeQueuePoll();
+  eeQueueAddr[h] = addr;
+  eeQueueData[h] = data;
+  eeQueueHead = (h + 1) & (EEQUEUE_SIZE - 1);
+}
+
+/* blocks until all queued bytes are written */
+static void eeQueueFlush(void) {
+  while (eeQueueTail != eeQueueHead) eeQueuePoll();
+  eeprom_busy_wait();
+}
+#endif
+
+#if USE_LZ_WRITE
+/*
+ * Streaming decoder of USBASP_FUNC_WRITEFLASHLZ (see tools/lzss.h for the
+ * format): a flag byte announces 8 items, LSB first; a set bit is a
+ * literal byte, a cleared bit a match of 2 bytes holding distance - 1 in
+ * the low LZ_WINDOW_BITS bits and length - 3 above, copied from the last
+ * 1 << LZ_WINDOW_BITS bytes of output. The window is a ring in RAM, its
+ * default size depends on the RAM of the device; the host has to use the
+ * same LZ_WINDOW_BITS. The state survives between transfers, a stream may
+ * be split anywhere.
+ */
+#ifndef LZ_WINDOW_BITS
+#  if (RAMEND) >= 0x10ff
+#    define LZ_WINDOW_BITS	11
+#  elif (RAMEND) >= 0x08ff
+#    define LZ_WINDOW_BITS	10
+#  else
+#    define LZ_WINDOW_BITS	8
+#  endif
+#endif
+#if (LZ_WINDOW_BITS < 8) || (LZ_WINDOW_BITS > 12)
+#  error "LZ_WINDOW_BITS must be between 8 and 12"
+#endif
+#define LZ_WINDOW		(1 << (LZ_WINDOW_BITS))
+
+#if LZ_WINDOW_BITS > 8
+typedef uint			lzpos_t;
+#  define LZ_WRAP(i)		((i) & (LZ_WINDOW - 1))
+#else
+typedef uchar			lzpos_t;	/* wraps the 256 byte ring for free */
+#  define LZ_WRAP(i)		(i)
+#endif
+
+static uchar            	lzWindow[LZ_WINDOW];
+static lzpos_t          	lzPos;		/* next write position in lzWindow */
+static uint             	lzFlags;	/* remaining flag bits above a 1 bit sentinel, 0 if refused */
+static uchar            	lzDistance;	/* first byte of a match, valid if lzInMatch */
+static uchar            	lzInMatch;
+
+static void lzPut(uchar c) {
+  lzWindow[lzPos] = c;
+  lzPos = LZ_WRAP(lzPos + 1);
+#if HAVE_BLB11_SOFTW_LOCKBIT
+  if (CURRENT_ADDRESS >= (addr_t)(BOOTLOADER_PAGEADDR)) return;
+#endif
+  pageBufferPut(c);
+}
+
+static void lzDecode(uchar c) {
+  if (lzFlags <= 1) {
+    lzFlags = c | 0x100;
+  } else if (lzFlags & 1) {
+    lzPut(c);
+    lzFlags >>= 1;
+  } else if (!lzInMatch) {
+    lzDistance = c;
+    lzInMatch = 1;
+  } else {
+    lzpos_t from = LZ_WRAP(lzPos - (lzDistance | ((uint)(c & ((1 << (LZ_WINDOW_BITS - 8)) - 1)) << 8)) - 1);
+    uint    n = (c >> (LZ_WINDOW_BITS - 8)) + 3;
+
+    do {
+      lzPut(lzWindow[from]);
+      from = LZ_WRAP(from + 1);
+    } while (--n);
+    lzInMatch = 0;
+    lzFlags >>= 1;
+  }
+}
+#endif
+
+#if (USE_MEMORY_CRC) || (USE_PAGE_DIGESTS)
+/*
+ * Returns the CRC16-CCITT (as computed by _crc_ccitt_update(), start
+ * value 0xffff) of len bytes (0 means 65536) of flash or EEPROM starting
+ * at currentAddress. currentAddress is advanced behind the range.
+ */
+static uint memoryCrc(uchar eeprom, uint len) {
+  uint  crc = 0xffff;
+  uint  offset = currentAddress.w[0];
+#if ((FLASHEND) > 65535)
+  uchar page = currentAddress.b[2];
+#endif
+
+  do {
+    if (eeprom) {
+      crc = _crc_ccitt_update(crc, eeprom_read_byte((void *)offset));
+    } else {
+      crc = _crc_ccitt_update(crc, FLASH_READ(page, offset));
+    }
+    offset++;
+#if ((FLASHEND) > 65535)
+    if (!offset) page++;
+#endif
+  } while (--len);
+  currentAddress.w[0] = offset;
+#if ((FLASHEND) > 65535)
+  currentAddress.b[2] = page;
+#endif
+  return crc;
+}
+#endif
+
+#if HAVE_PAGEBUFFER
+/*
+ * True for the ISP commands of USBASP_FUNC_TRANSMIT which read or write
+ * flash, fuses or EEPROM and so have to wait for pending page writes and
+ * a background chip erase. Program enable, the signature and the RDY/BSY
+ * poll are answered at once.
+ */
+static uchar transmitTouchesMemory(usbRequest_t *rq) {
+  uchar cmd = rq->wValue.bytes[0];
+
+  return cmd == 0x20 || cmd == 0x28 || cmd == 0x50 || cmd == 0x58 ||
+         cmd == 0xa0 || cmd == 0xc0 || (cmd == 0xac && rq->wValue.bytes[1] == 0x80);
+}
+#endif
 
 uchar usbFunctionSetup_USBASP_FUNC_TRANSMIT(usbRequest_t *rq) {
   uchar rval = 0;
@@ -269,6 +1107,10 @@ uchar usbFunctionSetup_USBASP_FUNC_TRANSMIT(usbRequest_t *rq) {
   address.bytes[1] = rq->wValue.bytes[1];
   address.bytes[0] = rq->wIndex.bytes[0];
 
+#if USE_EEPROM_QUEUE
+  /* only byte writes may pass queued EEPROM data */
+  if(rq->wValue.bytes[0] != 0xc0) eeQueueFlush();
+#endif
   if(rq->wValue.bytes[0] == 0x30){        /* read signature */
     rval = rq->wIndex.bytes[0] & 3;
     rval = signatureBytes[rval];
@@ -327,10 +1169,26 @@ defined (__AVR_ATmega2561__)
   }else if(rq->wValue.bytes[0] == 0xa0){  /* read EEPROM byte */
       rval = eeprom_read_byte((void *)address.word);
   }else if(rq->wValue.bytes[0] == 0xc0){  /* write EEPROM byte */
-      eeprom_write_byte((void *)address.word, rq->wIndex.bytes[1]);
+#if USE_EEPROM_QUEUE
+      eeQueuePut(address.word, rq->wIndex.bytes[1]);
+#else
+      EEPROM_WRITE(address.word, rq->wIndex.bytes[1]);
+#endif
+#endif
+#if HAVE_PAGEBUFFER
+  }else if(rq->wValue.bytes[0] == 0xf0){  /* poll RDY/BSY */
+      rval = pagePending || (spmState != SPMSTATE_IDLE) || boot_spm_busy();
+#  if USE_BACKGROUND_CHIPERASE
+      rval |= chipEraseRunning;
+#  endif
 #endif
 #if HAVE_CHIP_ERASE
   }else if(rq->wValue.bytes[0] == 0xac && rq->wValue.bytes[1] == 0x80){  /* chip erase */
+#if USE_BACKGROUND_CHIPERASE
+      /* pages are erased from the main loop, see pageCommitPoll() */
+      chipEraseAddress = 0;
+      chipEraseRunning = 1;
+#else
       addr_t addr;
 #if HAVE_BLB11_SOFTW_LOCKBIT
       for(addr = 0; addr < (addr_t)(BOOTLOADER_PAGEADDR) ; addr += SPM_PAGESIZE) {
@@ -339,13 +1197,24 @@ defined (__AVR_ATmega2561__)
 #endif
 	  /* wait and erase page */
 	  DBG1(0x33, 0, 0);
+	  STATS_INC(pagesErased);
 #   ifndef NO_FLASH_WRITE
-	  boot_spm_busy_wait();
+	  {
+	    STATS_BEGIN(start);
+
+	    boot_spm_busy_wait();
+	    STATS_END(spmWaitTicks, start);
+	  }
 	  cli();
 	  boot_page_erase(addr);
 	  sei();
 #   endif
       }
+#if USE_ERASED_PAGEMAP
+      /* pages of the boot loader are never written, so just mark all */
+      memset(erasedPages, 0xff, sizeof(erasedPages));
+#endif
+#endif
 #endif
   }else{
       /* ignore all others, return default value == 0 */
@@ -354,6 +1223,95 @@ defined (__AVR_ATmega2561__)
   return rval;
 }
 
+#if USE_ISP_BATCH
+#define ISP_BATCH_MAX		16	/* instructions per USBASP_FUNC_TRANSMITBATCH */
+
+static usbRequest_t     	batchRq;	/* instruction being collected, placed like USBASP_FUNC_TRANSMIT's */
+static uchar            	batchFill;	/* bytes of batchRq collected */
+static uchar            	batchCount;	/* instructions executed */
+static uchar            	batchResults[ISP_BATCH_MAX];
+#endif
+
+#if USE_CAPABILITIES
+#define CAPS_VERSION		1
+
+/* extension feature bits of USBASP_FUNC_GETCAPABILITIES */
+#define CAPS_LONG_TRANSFERS		(1UL << 0)
+#define CAPS_MEMORY_CRC			(1UL << 1)
+#define CAPS_PAGE_DIGESTS		(1UL << 2)
+#define CAPS_LZ_WRITE			(1UL << 3)
+#define CAPS_ISP_BATCH			(1UL << 4)
+#define CAPS_WRITE_VERIFY		(1UL << 5)
+#define CAPS_TRACE			(1UL << 6)
+#define CAPS_STATS			(1UL << 7)
+#define CAPS_ZEROCOPY_READFLASH		(1UL << 8)
+#define CAPS_PAGE_PIPELINE		(1UL << 9)
+#define CAPS_PAGE_COMPARE		(1UL << 10)
+#define CAPS_PAGE_ERASE_ELISION		(1UL << 11)
+#define CAPS_ERASED_PAGEMAP		(1UL << 12)
+#define CAPS_BACKGROUND_CHIPERASE	(1UL << 13)
+#define CAPS_EEPROM_QUEUE		(1UL << 14)
+#define CAPS_EEPROM_UPDATE		(1UL << 15)
+#define CAPS_CHIP_ERASE			(1UL << 16)
+#define CAPS_ONDEMAND_PAGEERASE		(1UL << 17)
+#define CAPS_CAN_EXIT			(1UL << 18)
+#define CAPS_EEPROM_PAGED_ACCESS	(1UL << 19)
+
+#define CAPS_FEATURES		((USE_LONG_TRANSFERS ? CAPS_LONG_TRANSFERS : 0) | \
+				 (USE_MEMORY_CRC ? CAPS_MEMORY_CRC : 0) | \
+				 (USE_PAGE_DIGESTS ? CAPS_PAGE_DIGESTS : 0) | \
+				 (USE_LZ_WRITE ? CAPS_LZ_WRITE : 0) | \
+				 (USE_ISP_BATCH ? CAPS_ISP_BATCH : 0) | \
+				 (USE_WRITE_VERIFY ? CAPS_WRITE_VERIFY : 0) | \
+				 (USE_TRACE ? CAPS_TRACE : 0) | \
+				 (USE_STATS ? CAPS_STATS : 0) | \
+				 (USE_ZEROCOPY_READFLASH ? CAPS_ZEROCOPY_READFLASH : 0) | \
+				 (USE_PAGE_PIPELINE ? CAPS_PAGE_PIPELINE : 0) | \
+				 (USE_PAGE_COMPARE ? CAPS_PAGE_COMPARE : 0) | \
+				 (USE_PAGE_ERASE_ELISION ? CAPS_PAGE_ERASE_ELISION : 0) | \
+				 (USE_ERASED_PAGEMAP ? CAPS_ERASED_PAGEMAP : 0) | \
+				 (USE_BACKGROUND_CHIPERASE ? CAPS_BACKGROUND_CHIPERASE : 0) | \
+				 (USE_EEPROM_QUEUE ? CAPS_EEPROM_QUEUE : 0) | \
+				 (USE_EEPROM_UPDATE ? CAPS_EEPROM_UPDATE : 0) | \
+				 (HAVE_CHIP_ERASE ? CAPS_CHIP_ERASE : 0) | \
+				 (HAVE_ONDEMAND_PAGEERASE ? CAPS_ONDEMAND_PAGEERASE : 0) | \
+				 (BOOTLOADER_CAN_EXIT ? CAPS_CAN_EXIT : 0) | \
+				 (HAVE_EEPROM_PAGED_ACCESS ? CAPS_EEPROM_PAGED_ACCESS : 0))
+
+/*
+ * Reply of USBASP_FUNC_GETCAPABILITIES, little endian. The first 4 bytes
+ * are the capabilities of a USBasp programmer (bit 0: TPI), all clear:
+ * AVRDUDE asks for these 4 only and keeps talking plain USBasp. A host
+ * asking for more gets the extensions; the multibyte fields are aligned
+ * to their size.
+ */
+static const struct {
+    uchar   usbasp[4];
+    uchar   version;		/* CAPS_VERSION */
+    uchar   size;		/* of this structure, later versions append */
+    uint    pageSize;		/* SPM_PAGESIZE */
+    ulong   features;		/* CAPS_* */
+    ulong   flashSize;
+    ulong   appSize;		/* BOOTLOADER_ADDRESS */
+    uint    eepromSize;
+    uchar   lzWindowBits;	/* 0 without USE_LZ_WRITE */
+    uchar   ispBatchMax;	/* 0 without USE_ISP_BATCH */
+} capabilities = {
+    { 0, 0, 0, 0 }, CAPS_VERSION, sizeof(capabilities), SPM_PAGESIZE, CAPS_FEATURES,
+    (FLASHEND) + 1UL, BOOTLOADER_ADDRESS, (E2END) + 1,
+#if USE_LZ_WRITE
+    LZ_WINDOW_BITS,
+#else
+    0,
+#endif
+#if USE_ISP_BATCH
+    ISP_BATCH_MAX
+#else
+    0
+#endif
+};
+#endif
+
 
 usbMsgLen_t usbFunctionSetup(uchar data[8])
 {
@@ -362,6 +1320,47 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
     static uchar    replyBuffer[4];
 
     usbMsgPtr = (usbMsgPtr_t)replyBuffer;
+    TRACE(TRACE_SETUP, rq->bRequest);
+    STATS_INC(setups);
+
+#if HAVE_PAGEBUFFER
+    /* requests accessing memory need programming (and a chip erase) to be finished */
+    if(rq->bRequest != USBASP_FUNC_WRITEFLASH && rq->bRequest != USBASP_FUNC_SETLONGADDRESS &&
+#if USE_LZ_WRITE
+       rq->bRequest != USBASP_FUNC_WRITEFLASHLZ &&
+#endif
+       rq->bRequest != USBASP_FUNC_CONNECT && rq->bRequest != USBASP_FUNC_ENABLEPROG &&
+       !(rq->bRequest == USBASP_FUNC_TRANSMIT && !transmitTouchesMemory(rq)))
+        pageCommitFlush();
+#endif
+
+#if USE_EEPROM_QUEUE
+    /* everything but further EEPROM writes waits for queued ones */
+    if(rq->bRequest != USBASP_FUNC_WRITEEEPROM && rq->bRequest != USBASP_FUNC_SETLONGADDRESS &&
+#if USE_ISP_BATCH
+       rq->bRequest != USBASP_FUNC_TRANSMITBATCH &&
+#endif
+       rq->bRequest != USBASP_FUNC_TRANSMIT)
+        eeQueueFlush();
+#endif
+
+#if USE_WRITE_VERIFY
+    if(rq->bRequest == USBASP_FUNC_CONNECT){
+	verifyStatus.errors = 0;
+    }
+#endif
+
+#if USE_TRACE
+    if(rq->bRequest == USBASP_FUNC_CONNECT){
+	traceClear();
+    }
+#endif
+
+#if USE_STATS
+    if(rq->bRequest == USBASP_FUNC_CONNECT){
+	statsClear();
+    }
+#endif
 
 #if I2C_LCD
     if(rq->bRequest == USBASP_FUNC_CONNECT){
@@ -383,20 +1382,120 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
             currentAddress.w[1] = rq->wIndex.word;
 #endif
         }else{
+#if USB_CFG_LONG_TRANSFERS
+            bytesRemaining = rq->wLength.word;
+#else
             bytesRemaining = rq->wLength.bytes[0];
+#endif
             /* if(rq->bRequest == USBASP_FUNC_WRITEFLASH) only evaluated during writeFlash anyway */
             isLastPage = rq->wIndex.bytes[1] & 0x02;
 #if HAVE_EEPROM_PAGED_ACCESS
             currentRequest = rq->bRequest;
+#elif (USE_PAGE_DIGESTS) || (USE_LZ_WRITE) || (USE_ISP_BATCH)
+            currentRequest = 0;
 #endif
             len = USB_NO_MSG; /* hand over to usbFunctionRead() / usbFunctionWrite() */
+#if USE_ZEROCOPY_READFLASH
+            /* let the driver read the flash unless the transfer wraps a 64 k page */
+            if(rq->bRequest == USBASP_FUNC_READFLASH && bytesRemaining &&
+               (uint16_t)(currentAddress.w[0] + bytesRemaining - 1) >= currentAddress.w[0]){
+                usbMsgPtr = (usbMsgPtr_t)currentAddress.w[0];
+                usbMsgFlags = USB_FLG_MSGPTR_IS_ROM;
+#  if ((FLASHEND) > 0xffff)
+                usbMsgFlashPage = currentAddress.b[2];
+#  endif
+                len = bytesRemaining;
+            }
+#endif
         }
 
+#if USE_WRITE_VERIFY
+    }else if(rq->bRequest == USBASP_FUNC_GETVERIFYSTATUS){
+        /* all flash data has been programmed and verified by now */
+        usbMsgPtr = (usbMsgPtr_t)&verifyStatus;
+        len = (usbMsgLen_t)6;
+#endif
+#if USE_MEMORY_CRC
+    }else if(rq->bRequest == USBASP_FUNC_GETFLASHCRC || rq->bRequest == USBASP_FUNC_GETEEPROMCRC){
+        /* start address like USBASP_FUNC_READFLASH, length in wIndex */
+        uint crc;
+        currentAddress.w[0] = rq->wValue.word;
+        crc = memoryCrc(rq->bRequest == USBASP_FUNC_GETEEPROMCRC, rq->wIndex.word);
+        replyBuffer[0] = crc;
+        replyBuffer[1] = crc >> 8;
+        len = (usbMsgLen_t)2;
+#endif
+#if USE_PAGE_DIGESTS
+    }else if(rq->bRequest == USBASP_FUNC_GETPAGECRCS){
+        /* one CRC (2 bytes) per page starting at the page of wValue */
+        currentAddress.w[0] = rq->wValue.word & ~(SPM_PAGESIZE - 1);
+        /* whole CRCs only, an odd last byte is not sent (short reply) */
+#if USB_CFG_LONG_TRANSFERS
+        bytesRemaining = rq->wLength.word & ~1;
+#else
+        bytesRemaining = rq->wLength.bytes[0] & ~1;
+#endif
+        currentRequest = rq->bRequest;
+        len = USB_NO_MSG; /* hand over to usbFunctionRead() */
+#endif
+#if USE_LZ_WRITE
+    }else if(rq->bRequest == USBASP_FUNC_WRITEFLASHLZ){
+        /* wIndex: bit 0 starts a new stream at wValue, bit 1 ends it, the
+         * high byte is the window of the encoder, which must be ours */
+        if(rq->wIndex.bytes[1] != LZ_WINDOW_BITS){
+            lzFlags = 0;    /* usbFunctionWrite() stalls */
+        }else if(rq->wIndex.bytes[0] & 0x01){
+            currentAddress.w[0] = rq->wValue.word;
+            lzFlags = 1;
+            lzInMatch = 0;
+        }
+#if USB_CFG_LONG_TRANSFERS
+        bytesRemaining = rq->wLength.word;
+#else
+        bytesRemaining = rq->wLength.bytes[0];
+#endif
+        isLastPage = rq->wIndex.bytes[0] & 0x02;
+        currentRequest = rq->bRequest;
+        len = USB_NO_MSG; /* hand over to usbFunctionWrite() */
+#endif
+#if USE_ISP_BATCH
+    }else if(rq->bRequest == USBASP_FUNC_TRANSMITBATCH){
+        /* wLength/4 instructions, executed by usbFunctionWrite() as they arrive */
+        batchFill = 0;
+        batchCount = 0;
+#if USB_CFG_LONG_TRANSFERS
+        bytesRemaining = rq->wLength.word;
+#else
+        bytesRemaining = rq->wLength.bytes[0];
+#endif
+        currentRequest = rq->bRequest;
+        len = USB_NO_MSG; /* hand over to usbFunctionWrite() */
+    }else if(rq->bRequest == USBASP_FUNC_GETBATCHRESULTS){
+        usbMsgPtr = (usbMsgPtr_t)batchResults;
+        len = (usbMsgLen_t)batchCount;
+#endif
+#if USE_TRACE
+    }else if(rq->bRequest == USBASP_FUNC_GETTRACE){
+        usbMsgPtr = (usbMsgPtr_t)&trace;
+        len = (usbMsgLen_t)sizeof(trace);
+#endif
+#if USE_STATS
+    }else if(rq->bRequest == USBASP_FUNC_GETSTATS){
+        usbMsgPtr = (usbMsgPtr_t)&stats;
+        len = (usbMsgLen_t)sizeof(stats);
+#endif
+#if USE_CAPABILITIES
+    }else if(rq->bRequest == USBASP_FUNC_GETCAPABILITIES){
+        /* the driver cuts the reply to wLength */
+        usbMsgPtr = (usbMsgPtr_t)&capabilities;
+        len = (usbMsgLen_t)sizeof(capabilities);
+#endif
     }else if(rq->bRequest == USBASP_FUNC_DISCONNECT){
 #if BOOTLOADER_CAN_EXIT
       stayInLoader &= (0xfe);
   #if EXIT_AFTER_UPLOAD
-      requestExit = 1;
+      /* status stage: OUT after a data stage, else the zero sized IN packet */
+      requestExit = rq->wLength.word ? USBPID_OUT : USBPID_SETUP;
     #if I2C_LCD
       LCD_setCursor(0, 1);
       LCD_writeStr("reset... ");
@@ -420,85 +1519,214 @@ usbMsgLen_t usbFunctionSetup(uchar data[8])
 uchar usbFunctionWrite(uchar *data, uchar len)
 {
 uchar   i,isLast;
+STATS_BEGIN(start);
 
     DBG1(0x31, (void *)&currentAddress.l, 4);
     if(len > bytesRemaining)
         len = bytesRemaining;
     bytesRemaining -= len;
     isLast = bytesRemaining == 0;
+#if USE_LZ_WRITE
+    if(currentRequest == USBASP_FUNC_WRITEFLASHLZ){
+        if(!lzFlags)    /* wrong window or no stream started */
+            return 0xff;
+        for(i = 0; i < len; i++)
+            lzDecode(data[i]);
+        /* commit the last partial page of the stream */
+        if(isLast && isLastPage && (currentAddress.w[0] & (SPM_PAGESIZE - 1)))
+            pageBufferCommit();
+    }else
+#endif
+#if USE_ISP_BATCH
+    if(currentRequest == USBASP_FUNC_TRANSMITBATCH){
+        for(i = 0; i < len; i++){
+            ((uchar *)&batchRq.wValue)[batchFill++] = data[i];
+            if(batchFill == 4){
+                batchFill = 0;
+                if(batchCount < ISP_BATCH_MAX)
+                    batchResults[batchCount++] = usbFunctionSetup_USBASP_FUNC_TRANSMIT(&batchRq);
+            }
+        }
+    }else
+#endif
     for(i = 0; i < len;) {
       if(currentRequest >= USBASP_FUNC_READEEPROM){
-	eeprom_write_byte((void *)(currentAddress.w[0]++), *data++);
+#if USE_EEPROM_QUEUE
+	eeQueuePut(currentAddress.w[0]++, *data++);
+#else
+	EEPROM_WRITE(currentAddress.w[0]++, *data++);
+#endif
 	i++;
       } else {
 #if HAVE_BLB11_SOFTW_LOCKBIT
 	if (CURRENT_ADDRESS >= (addr_t)(BOOTLOADER_PAGEADDR)) {
+	  STATS_END(writeTicks, start);
 	  return 1;
 	}
 #endif
+#if HAVE_PAGEBUFFER
+	i++;
+	DBG1(0x32, 0, 0);
+	pageBufferPut(*data++);
+	/* full pages are committed by pageBufferPut(), the last partial page here */
+	if(isLast && i >= len && isLastPage && (currentAddress.w[0] & (SPM_PAGESIZE - 1)))
+	    pageBufferCommit();
+#else
+#  if USE_TRACE
+	if ((currentAddress.w[0] & (SPM_PAGESIZE - 1)) == 0) TRACE(TRACE_FILL, TRACE_PAGE(CURRENT_ADDRESS));
+#  endif
+#  if USE_ASM_PAGEFILL
+	{
+	  /* the rest of this chunk, as far as it fits into the current page */
+	  uint  room = SPM_PAGESIZE - (currentAddress.w[0] & (SPM_PAGESIZE - 1));
+	  uchar n = len - i;
+
+	  if (n > room) n = room;
+	  /* whole words only; a lone last byte fills a word, as the C loop does */
+	  n &= ~1;
+	  if (!n) n = 2;
+	  DBG1(0x32, 0, 0);
+	  pageFill(currentAddress.w[0], data, n);
+	  i += n;
+	  ADVANCE_ADDRESS(n);
+	  data += n;
+	}
+#  else
 	i += 2;
 	DBG1(0x32, 0, 0);
 	cli();
-	boot_page_fill(CURRENT_ADDRESS, *(short *)data);
+	boot_page_fill(currentAddress.w[0], *(short *)data);   /* only the page offset matters */
 	sei();
-	CURRENT_ADDRESS += 2;
+	ADVANCE_ADDRESS(2);
 	data += 2;
+#  endif
 	/* write page when we cross page boundary or we have the last partial page */
 	if((currentAddress.w[0] & (SPM_PAGESIZE - 1)) == 0 || (isLast && i >= len && isLastPage)){
+	    TRACE(TRACE_FILLED, TRACE_PAGE(CURRENT_ADDRESS - 2));
+	    STATS_INC(pagesFilled);
 #if (!HAVE_CHIP_ERASE) || (HAVE_ONDEMAND_PAGEERASE)
 	    DBG1(0x33, 0, 0);
+	    TRACE(TRACE_ERASE, TRACE_PAGE(CURRENT_ADDRESS - 2));
+	    STATS_INC(pagesErased);
 #   ifndef NO_FLASH_WRITE
 	    cli();
 	    boot_page_erase(CURRENT_ADDRESS - 2);   /* erase page */
 	    sei();
-	    boot_spm_busy_wait();                   /* wait until page is erased */
+	    SPM_BUSY_WAIT(eraseTicks);              /* wait until page is erased */
 #   endif
 #endif
 	    DBG1(0x34, 0, 0);
+	    TRACE(TRACE_WRITE, TRACE_PAGE(CURRENT_ADDRESS - 2));
+	    STATS_INC(pagesWritten);
 #ifndef NO_FLASH_WRITE
 	    cli();
 	    boot_page_write(CURRENT_ADDRESS - 2);
 	    sei();
-	    boot_spm_busy_wait();
+	    SPM_BUSY_WAIT(pageWriteTicks);
 	    cli();
 	    boot_rww_enable();
 	    sei();
 #endif
+	    TRACE(TRACE_RWWENABLE, TRACE_PAGE(CURRENT_ADDRESS - 2));
 	}
+#endif
         }
         DBG1(0x35, (void *)&currentAddress.l, 4);
     }
+#if USE_PAGE_PIPELINE
+    /* NAK further data until the main loop could hand over the page */
+    if (pagePending && !isLast) usbDisableAllRequests();
+#endif
+#if USE_EEPROM_QUEUE
+    /* NAK further data until the main loop made room for a packet */
+    if (EEQUEUE_ROOM() < 8 && !isLast) usbDisableAllRequests();
+#endif
+    STATS_END(writeTicks, start);
     return isLast;
 }
 
 uchar usbFunctionRead(uchar *data, uchar len)
 {
 uchar   i;
+uint    offset;
+#if ((FLASHEND) > 65535)
+uchar   page;
+#endif
+STATS_BEGIN(start);
 
     if(len > bytesRemaining)
         len = bytesRemaining;
     bytesRemaining -= len;
+#if USE_PAGE_DIGESTS
+    if(currentRequest == USBASP_FUNC_GETPAGECRCS){
+        /* chunks are 8 bytes and bytesRemaining is even, so the 2 bytes of a page never get split */
+        for(i = 0; i < len; i += 2){
+            uint crc = memoryCrc(0, SPM_PAGESIZE);
+            data[i] = crc;
+            data[i+1] = crc >> 8;
+        }
+        STATS_END(readTicks, start);
+        return len;
+    }
+#endif
+    offset = currentAddress.w[0];
+#if ((FLASHEND) > 65535)
+    page = currentAddress.b[2];
+#endif
     for(i = 0; i < len; i++){
         if(currentRequest >= USBASP_FUNC_READEEPROM){
-            *data = eeprom_read_byte((void *)currentAddress.w[0]);
+            *data = eeprom_read_byte((void *)offset);
         }else{
-#if ((FLASHEND) > 65535)
-            *data = pgm_read_byte_far(CURRENT_ADDRESS);
-#else
-            *data = pgm_read_byte(CURRENT_ADDRESS);
-#endif
+            *data = FLASH_READ(page, offset);
         }
         data++;
-        CURRENT_ADDRESS++;
+        offset++;
+#if ((FLASHEND) > 65535)
+        if(!offset) page++;
+#endif
     }
+    currentAddress.w[0] = offset;
+#if ((FLASHEND) > 65535)
+    currentAddress.b[2] = page;
+#endif
+    STATS_END(readTicks, start);
     return len;
 }
 
 /* ------------------------------------------------------------------------ */
 
+#if USE_FAST_ENUMERATION
+#ifndef USB_DISCONNECT_MS
+#  define USB_DISCONNECT_MS	10	/* hubs latch a disconnect after 2.5 us of SE0 */
+#endif
+#define USB_DISCONNECT_TICKS	((F_CPU) / 64 * (USB_DISCONNECT_MS) / 1000)
+#if USB_DISCONNECT_TICKS > 0xffff
+#  error "USB_DISCONNECT_MS is too long for timer 1"
+#endif
+#endif
+
+#if EXIT_AFTER_UPLOAD
+/*
+ * True once the answer to USBASP_FUNC_DISCONNECT is complete on the bus:
+ * the driver has sent its last IN packet and, for a transfer with a data
+ * stage, the status stage OUT token arrived. The interrupt routine takes
+ * a token and the data packet following it (and ACKs it) in one go, so
+ * the main loop never sees usbCurrentTok change before the ACK is out.
+ * If the host never completes the transfer, the boot loader leaves after
+ * 65536 loop iterations.
+ */
+static uchar exitDue(void) {
+    if(!requestExit)
+        return 0;
+    if(usbCurrentTok == requestExit && usbTxLen == USBPID_NAK && usbMsgLen == USB_NO_MSG)
+        return 1;
+    return !--exitTimeout;
+}
+#endif
+
 static void initForUsbConnectivity(void)
 {
-#if HAVE_UNPRECISEWAIT
+#if (HAVE_UNPRECISEWAIT) && (!USE_FAST_ENUMERATION)
     /* (0.25s*F_CPU)/(4 cycles per loop) ~ (65536*waitloopcnt)
      * F_CPU/(16*65536) ~ waitloopcnt
      * F_CPU / 1048576 ~ waitloopcnt
@@ -506,6 +1734,16 @@ static void initForUsbConnectivity(void)
     uint8_t waitloopcnt = 1 + (F_CPU/1048576);
 #endif
     usbInit();
+#if USE_FAST_ENUMERATION
+    /* enforce USB re-enumerate: hold SE0 for USB_DISCONNECT_MS, timed by timer 1 */
+    {
+        uint start = TCNT1;
+
+        usbDeviceDisconnect();  /* do this while interrupts are disabled */
+        while((uint)(TCNT1 - start) < USB_DISCONNECT_TICKS)
+            ;
+    }
+#else
     /* enforce USB re-enumerate: */
     usbDeviceDisconnect();  /* do this while interrupts are disabled */
 #if HAVE_UNPRECISEWAIT
@@ -524,28 +1762,15 @@ static void initForUsbConnectivity(void)
     );
 #else
     _delay_ms(260);         /* fake USB disconnect for > 250 ms */
+#endif
 #endif
     usbDeviceConnect();
     sei();
 }
 
-int __attribute__((__noreturn__)) main(void)
+/* everything between the reset checks in main() and its event loop */
+static void bootLoaderStart(void)
 {
-    /* initialize  */
-    bootLoaderInit();
-    wdt_reset();
-
-    if(!(MCUCSR & (1 << EXTRF))){   /* If this was not an external reset, ignore */
-        leaveBootloader();
-    }
-
-    odDebugInit();
-    DBG1(0x00, 0, 0);
-#ifndef NO_FLASH_WRITE
-    GICR = (1 << IVCE);  /* enable change of interrupt vectors */
-    GICR = (1 << IVSEL); /* move interrupts to boot flash section */
-#endif
-    if(bootLoaderCondition()){
 #if NEED_WATCHDOG
 #	if (defined(MCUSR) && defined(WDRF))
 	/* 
@@ -559,14 +1784,33 @@ int __attribute__((__noreturn__)) main(void)
 	wdt_disable();    /* main app may have enabled watchdog */
 #endif
 	MCUCSR = 0;       /* clear all reset flags for next time */
+#if HAVE_PAGEBUFFER
+	memset(pageBuffer, 0xff, sizeof(pageBuffer));
+#endif
+#if USE_TRACE
+	traceClear();
+#endif
+#if HAVE_TIMER1
+	TIMER1_START();
+#endif
 #if I2C_LCD
 	LCD_init();
 	LCD_setCursor(0, 0);
 	LCD_writeStr("Bootloader");
 #endif
-        initForUsbConnectivity();
-        do{
-            usbPoll();
+	initForUsbConnectivity();
+}
+
+/* one pass of the main event loop, returns 0 once the boot loader should leave */
+static uchar bootLoaderPoll(void)
+{
+	usbPoll();
+#if HAVE_PAGEBUFFER
+	pageCommitPoll();
+#endif
+#if USE_EEPROM_QUEUE
+	eeQueuePoll();
+#endif
 #if BOOTLOADER_CAN_EXIT
 	if (stayInLoader >= 0x10) {
 	  if (!bootLoaderCondition()) {
@@ -577,18 +1821,48 @@ int __attribute__((__noreturn__)) main(void)
 	    if (stayInLoader > 1) stayInLoader-=2;
 	  }
 	}
-#endif
-#if BOOTLOADER_CAN_EXIT
-  #if EXIT_AFTER_UPLOAD
-          if (requestExit) {
-            _delay_ms(500);
-            break;
-          }
-  #endif
-        }while (stayInLoader);	/* main event loop, if BOOTLOADER_CAN_EXIT*/
+#  if EXIT_AFTER_UPLOAD
+	if (exitDue())
+	  return 0;
+#  endif
+	return stayInLoader;
 #else
-        }while (1);  		/* main event loop */
+	return 1;
 #endif
+}
+
+/* completes the writes still pending when the event loop ends */
+static void bootLoaderFinish(void)
+{
+#if HAVE_PAGEBUFFER
+	pageCommitFlush();
+#endif
+#if USE_EEPROM_QUEUE
+	eeQueueFlush();
+#endif
+}
+
+int __attribute__((__noreturn__)) main(void)
+{
+    /* initialize  */
+    bootLoaderInit();
+    wdt_reset();
+
+    if(!(MCUCSR & (1 << EXTRF))){   /* If this was not an external reset, ignore */
+        leaveBootloader();
+    }
+
+    odDebugInit();
+    DBG1(0x00, 0, 0);
+#ifndef NO_FLASH_WRITE
+    GICR = (1 << IVCE);  /* enable change of interrupt vectors */
+    GICR = (1 << IVSEL); /* move interrupts to boot flash section */
+#endif
+    if(bootLoaderCondition()){
+        bootLoaderStart();
+        while(bootLoaderPoll())
+            ;	/* main event loop */
+        bootLoaderFinish();
     }
     leaveBootloader();
 }
@@ -93,10 +93,13 @@
  * interrupt/bulk data sent to any endpoint other than 0. The endpoint number
  * can be found in 'usbRxToken'.
  */
-#define USB_CFG_HAVE_FLOWCONTROL        0
+#define USB_CFG_HAVE_FLOWCONTROL        ((USE_PAGE_PIPELINE) || (USE_EEPROM_QUEUE))
 /* Define this to 1 if you want flowcontrol over USB data. See the definition
  * of the macros usbDisableAllRequests() and usbEnableAllRequests() in
  * usbdrv.h.
+ * The boot loader only needs it when pages are programmed in the background
+ * (USE_PAGE_PIPELINE) or EEPROM is written behind (USE_EEPROM_QUEUE, see
+ * bootloaderconfig.h).
  */
 #if defined(BOOTLOADER_ADDRESS)
 #	define USB_CFG_DRIVER_FLASH_PAGE       (BOOTLOADER_ADDRESS >> 16)
@@ -107,10 +110,22 @@
  * where the driver's constants (descriptors) are located. Or in other words:
  * Define this to 1 for boot loaders on the ATMega128.
  */
-#define USB_CFG_LONG_TRANSFERS          0
+#if (USE_ZEROCOPY_READFLASH) && ((FLASHEND) > 0xffff)
+#	ifndef __ASSEMBLER__
+extern unsigned char usbMsgFlashPage;
+#	endif
+#	define USB_READ_FLASH(addr)            pgm_read_byte_far(((long)usbMsgFlashPage << 16) | (long)(addr))
+#endif
+/* With USE_ZEROCOPY_READFLASH (see bootloaderconfig.h) the driver streams
+ * READFLASH data directly from the application's flash, so the 64 k page of
+ * ROM messages is not constant any more. usbMsgFlashPage holds it and is
+ * reset to USB_CFG_DRIVER_FLASH_PAGE by USB_RX_USER_HOOK with every SETUP.
+ */
+#define USB_CFG_LONG_TRANSFERS          USE_LONG_TRANSFERS
 /* Define this to 1 if you want to send/receive blocks of more than 254 bytes
  * in a single control-in or control-out transfer. Note that the capability
  * for long transfers increases the driver size.
+ * The boot loader enables it with USE_LONG_TRANSFERS (see bootloaderconfig.h).
  */
 /* #define USB_RX_USER_HOOK(data, len)     if(usbRxToken == (uchar)USBPID_SETUP) blinkLED(); */
 /* This macro is a hook if you want to do unconventional things. If it is
@@ -119,6 +134,9 @@
  * proceed, do a return after doing your things. One possible application
  * (besides debugging) is to flash a status LED on each packet.
  */
+#if (USE_ZEROCOPY_READFLASH) && ((FLASHEND) > 0xffff)
+#	define USB_RX_USER_HOOK(data, len)     if(usbRxToken == (uchar)USBPID_SETUP) usbMsgFlashPage = USB_CFG_DRIVER_FLASH_PAGE;
+#endif
 /* #define USB_RESET_HOOK(resetStarts)     if(!resetStarts){hadUsbReset();} */
 /* This macro is a hook if you need to know when an USB RESET occurs. It has
  * one parameter which distinguishes between the start of RESET state and its
@@ -305,12 +323,15 @@
 #define USB_CFG_DESCR_PROPS_UNKNOWN                 0
 
 
+#ifndef usbMsgPtr_t
 #define usbMsgPtr_t unsigned short
+#endif
 /* If usbMsgPtr_t is not defined, it defaults to 'uchar *'. We define it to
  * a scalar type here because gcc generates slightly shorter code for scalar
  * arithmetics than for pointer arithmetics. Remove this define for backward
  * type compatibility or define it to an 8 bit type if you use data in RAM only
  * and all RAM is below 256 bytes (tiny memory model in IAR CC).
+ * The hostsim build (see Makefile) defines it to a pointer sized type.
  */
 
 /* ----------------------- Optional MCU Description ------------------------ */
@@ -11,14 +11,68 @@
 
 #if DEBUG_LEVEL > 0
 
+#include <avr/interrupt.h>
+
 #warning "Never compile production devices with debugging enabled"
 
-static void uartPutc(char c)
+#if (ODDBG_TXBUF_SIZE & (ODDBG_TXBUF_SIZE - 1)) || ODDBG_TXBUF_SIZE > 256
+#   error "ODDBG_TXBUF_SIZE must be a power of 2 and at most 256"
+#endif
+
+#define ODDBG_WRAP(i)   ((uchar)(i) & (ODDBG_TXBUF_SIZE - 1))
+
+static uchar            txBuf[ODDBG_TXBUF_SIZE];
+static volatile uchar   txHead;     /* next free byte, written by odDebug() */
+static volatile uchar   txTail;     /* next byte to send, written by the interrupt */
+static uchar            txPut;      /* txHead of the log being copied */
+static uchar            dropped;    /* logs lost since the last report */
+
+/* The transmitter is the only user of the UART control register, so the
+ * interrupt can switch UDRIE off by writing a constant, which does not
+ * need SREG. Interrupts are enabled again after 4 instructions (see
+ * "Interrupt latency" in usbdrv.h), the rest runs in __vector_odDebugTx().
+ */
+ISR(ODDBG_UDRE_vect, ISR_NAKED)
+{
+    asm volatile(
+        "push   r24             \n\t"
+        "ldi    r24, %[txen]    \n\t"
+        "sts    %[ucr], r24     \n\t"
+        "pop    r24             \n\t"
+        "sei                    \n\t"
+        "rjmp   __vector_odDebugTx  \n\t"
+        :
+        : [txen] "M" (1 << ODDBG_TXEN),
+          [ucr] "n" (_SFR_MEM_ADDR(ODDBG_UCR))
+    );
+}
+
+void __vector_odDebugTx(void) __attribute__((signal, used));
+void __vector_odDebugTx(void)
 {
-    while(!(ODDBG_USR & (1 << ODDBG_UDRE)));    /* wait for data register empty */
-    ODDBG_UDR = c;
+uchar   t = txTail;
+
+    if(t == txHead)
+        return;
+    ODDBG_UDR = txBuf[t];
+    txTail = t = ODDBG_WRAP(t + 1);
+    /* Interrupts are enabled here (the stub ran sei), so UDRE nests as
+     * soon as UDRIE is set again if the byte just written went straight
+     * on to the shift register and UDR is empty. The nested handler then
+     * fills UDR, which stays full for a character time, so there is at
+     * most one nested level (two frames of this handler on the stack).
+     */
+    if(t != txHead)
+        ODDBG_UCR = (1 << ODDBG_TXEN) | (1 << ODDBG_UDRIE);
 }
 
+static void txPutc(uchar c)
+{
+    txBuf[txPut] = c;
+    txPut = ODDBG_WRAP(txPut + 1);
+}
+
+#if !ODDBG_BINARY
 static uchar    hexAscii(uchar h)
 {
     h &= 0xf;
@@ -30,20 +84,70 @@ static uchar    hexAscii(uchar h)
 
 static void printHex(uchar c)
 {
-    uartPutc(hexAscii(c >> 4));
-    uartPutc(hexAscii(c));
+    txPutc(hexAscii(c >> 4));
+    txPutc(hexAscii(c));
 }
+#endif
 
-void    odDebug(uchar prefix, uchar *data, uchar len)
+/* copies one log into the ring and starts the interrupt, returns 0 if it does not fit */
+static uchar    queueLog(uchar prefix, uchar *data, uchar len)
 {
+unsigned    room = ODDBG_WRAP(txTail - txHead - 1);
+
+#if ODDBG_BINARY
+    if(room < 3 + (unsigned)len)
+        return 0;
+    txPut = txHead;
+    txPutc(ODDBG_FRAME_SYNC);
+    txPutc(prefix);
+    txPutc(len);
+    while(len--)
+        txPutc(*data++);
+#else
+    if(room < 5 + 3 * (unsigned)len)    /* "xx:", " xx" per byte, "\r\n" */
+        return 0;
+    txPut = txHead;
     printHex(prefix);
-    uartPutc(':');
+    txPutc(':');
     while(len--){
-        uartPutc(' ');
+        txPutc(' ');
         printHex(*data++);
     }
-    uartPutc('\r');
-    uartPutc('\n');
+    txPutc('\r');
+    txPutc('\n');
+#endif
+    txHead = txPut;
+    ODDBG_UCR |= (1 << ODDBG_UDRIE);
+    return 1;
+}
+
+void    odDebug(uchar prefix, uchar *data, uchar len)
+{
+    if(dropped){
+        if(!queueLog(ODDBG_PREFIX_DROPPED, &dropped, 1))
+            goto drop;
+        dropped = 0;
+    }
+    if(queueLog(prefix, data, len))
+        return;
+drop:
+    if(dropped < 255)
+        dropped++;
+}
+
+/* sends everything queued without the interrupt, e.g. before interrupts get disabled for good */
+void    odDebugFlush(void)
+{
+uchar   sreg = SREG;
+
+    cli();
+    ODDBG_UCR &= ~(1 << ODDBG_UDRIE);
+    while(txTail != txHead){
+        while(!(ODDBG_USR & (1 << ODDBG_UDRE)));    /* wait for data register empty */
+        ODDBG_UDR = txBuf[txTail];
+        txTail = ODDBG_WRAP(txTail + 1);
+    }
+    SREG = sreg;
 }
 
 #endif
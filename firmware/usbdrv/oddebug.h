@@ -20,6 +20,14 @@ calls are no-ops. If it is 1, DBG1 logs will appear, but not DBG2. If it is
 
 A debug log consists of a label ('prefix') to indicate which debug log created
 the output and a memory block to dump in hex ('data' and 'len').
+
+odDebug() does not wait for the UART: logs are copied into a transmit ring
+of ODDBG_TXBUF_SIZE bytes which the UDRE interrupt drains in the
+background, so logging does not disturb the USB timing. A log which does
+not fit into the ring is dropped; the number of dropped logs is sent as a
+log with the label 0xff as soon as there is room again. With ODDBG_BINARY
+defined to 1, logs are sent as binary frames (ODDBG_FRAME_SYNC, label,
+length, data) instead of hex text, which takes a third of the bandwidth.
 */
 
 
@@ -43,6 +51,17 @@ the output and a memory block to dump in hex ('data' and 'len').
 #   define  DEBUG_LEVEL 0
 #endif
 
+#ifndef ODDBG_TXBUF_SIZE
+#   define  ODDBG_TXBUF_SIZE    64  /* power of 2, at most 256 */
+#endif
+
+#ifndef ODDBG_BINARY
+#   define  ODDBG_BINARY        0
+#endif
+
+#define ODDBG_FRAME_SYNC        0xa5    /* first byte of a binary frame */
+#define ODDBG_PREFIX_DROPPED    0xff    /* data: number of logs dropped */
+
 /* ------------------------------------------------------------------------- */
 
 #if DEBUG_LEVEL > 0
@@ -61,6 +80,7 @@ the output and a memory block to dump in hex ('data' and 'len').
 
 #if DEBUG_LEVEL > 0
 extern void odDebug(uchar prefix, uchar *data, uchar len);
+extern void odDebugFlush(void);
 
 /* Try to find our control registers; ATMEL likes to rename these */
 
@@ -102,6 +122,20 @@ extern void odDebug(uchar prefix, uchar *data, uchar len);
 #   define  ODDBG_UDRE  UDRE0
 #endif
 
+#if defined UDRIE
+#   define  ODDBG_UDRIE UDRIE
+#else
+#   define  ODDBG_UDRIE UDRIE0
+#endif
+
+#if defined USART_UDRE_vect
+#   define  ODDBG_UDRE_vect USART_UDRE_vect
+#elif defined USART0_UDRE_vect
+#   define  ODDBG_UDRE_vect USART0_UDRE_vect
+#elif defined UART_UDRE_vect
+#   define  ODDBG_UDRE_vect UART_UDRE_vect
+#endif
+
 #if defined UDR
 #   define  ODDBG_UDR   UDR
 #elif defined UDR0
@@ -115,6 +149,7 @@ static inline void  odDebugInit(void)
 }
 #else
 #   define odDebugInit()
+#   define odDebugFlush()
 #endif
 
 /* ------------------------------------------------------------------------- */
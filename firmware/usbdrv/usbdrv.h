@@ -667,7 +667,7 @@ extern usbTxStatus_t   usbTxStatus1, usbTxStatus3;
 
 
 typedef union usbWord{
-    unsigned    word;
+    unsigned short  word;
     uchar       bytes[2];
 }usbWord_t;
 
@@ -125,11 +125,13 @@ static inline void  sei(void)
 #   include <avr/pgmspace.h>
 #endif
 
+#ifndef USB_READ_FLASH  /* may be overridden in usbconfig.h */
 #if USB_CFG_DRIVER_FLASH_PAGE
 #   define USB_READ_FLASH(addr)    pgm_read_byte_far(((long)USB_CFG_DRIVER_FLASH_PAGE << 16) | (long)(addr))
 #else
 #   define USB_READ_FLASH(addr)    pgm_read_byte(addr)
 #endif
+#endif
 
 #define macro   .macro
 #define endm    .endm
@@ -0,0 +1,66 @@
+/* Name: caps.c
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-18
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Decoder of the boot loader's USBASP_FUNC_GETCAPABILITIES reply, used by
+ * usbaspdelta.c and the hostsim build.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "caps.h"
+
+static const char *featureNames[] = {
+	"long-transfers", "memory-crc", "page-digests", "lz-write", "isp-batch", "write-verify",
+	"trace", "stats", "zerocopy-readflash", "page-pipeline", "page-compare",
+	"page-erase-elision", "erased-pagemap", "background-chiperase", "eeprom-queue",
+	"eeprom-update", "chip-erase", "ondemand-pageerase", "can-exit", "eeprom-paged-access",
+};
+
+static uint32_t le(const uint8_t *p, int n)
+{
+	uint32_t v = 0;
+
+	while (n--)
+		v = (v << 8) | p[n];
+	return v;
+}
+
+int caps_parse(const uint8_t *buf, int len, caps_t *caps)
+{
+	memset(caps, 0, sizeof(*caps));
+	if ((len < CAPS_SIZE) || (buf[4] < 1) || (buf[5] < CAPS_SIZE))
+		return -1;
+	caps->version		= buf[4];
+	caps->page_size		= le(buf + 6, 2);
+	caps->features		= le(buf + 8, 4);
+	caps->flash_size	= le(buf + 12, 4);
+	caps->app_size		= le(buf + 16, 4);
+	caps->eeprom_size	= le(buf + 20, 2);
+	caps->lz_window_bits	= buf[22];
+	caps->isp_batch_max	= buf[23];
+	return 0;
+}
+
+void caps_print(FILE *f, const caps_t *caps)
+{
+	unsigned i;
+
+	fprintf(f, "version %u, %u bytes/page, %lu bytes flash, %lu for the application, %u bytes EEPROM\n",
+		caps->version, caps->page_size, (unsigned long)caps->flash_size,
+		(unsigned long)caps->app_size, caps->eeprom_size);
+	if (caps->lz_window_bits)
+		fprintf(f, "LZ window %u bits\n", caps->lz_window_bits);
+	if (caps->isp_batch_max)
+		fprintf(f, "%u instructions per batch\n", caps->isp_batch_max);
+	fprintf(f, "features:");
+	for (i = 0; i < sizeof(featureNames) / sizeof(featureNames[0]); i++)
+		if (caps->features & (1UL << i))
+			fprintf(f, " %s", featureNames[i]);
+	fprintf(f, "\n");
+}
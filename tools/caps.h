@@ -0,0 +1,78 @@
+/* Name: caps.h
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-18
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+#ifndef __caps_h_included__
+#define __caps_h_included__
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Reply of USBASP_FUNC_GETCAPABILITIES (boot loader built with
+ * CONFIG_USE__CAPABILITIES), little endian:
+ *
+ *   bytes 0..3    USBasp capabilities (bit 0: TPI), always 0
+ *   byte 4        version of the following fields (1)
+ *   byte 5        size of the reply
+ *   bytes 6..7    flash page size
+ *   bytes 8..11   CAPS_* feature bits
+ *   bytes 12..15  flash size
+ *   bytes 16..19  application section size (BOOTLOADER_ADDRESS)
+ *   bytes 20..21  EEPROM size
+ *   byte 22       LZ_WINDOW_BITS, 0 without CONFIG_USE__LZ_WRITE
+ *   byte 23       instructions per USBASP_FUNC_TRANSMITBATCH, 0 without
+ *                 CONFIG_USE__ISP_BATCH
+ *
+ * Other USBasp firmware answers with 4 bytes or none at all.
+ */
+#define USBASP_FUNC_GETCAPABILITIES	127
+
+#define CAPS_SIZE			24
+
+#define CAPS_LONG_TRANSFERS		(1UL << 0)
+#define CAPS_MEMORY_CRC			(1UL << 1)
+#define CAPS_PAGE_DIGESTS		(1UL << 2)
+#define CAPS_LZ_WRITE			(1UL << 3)
+#define CAPS_ISP_BATCH			(1UL << 4)
+#define CAPS_WRITE_VERIFY		(1UL << 5)
+#define CAPS_TRACE			(1UL << 6)
+#define CAPS_STATS			(1UL << 7)
+#define CAPS_ZEROCOPY_READFLASH		(1UL << 8)
+#define CAPS_PAGE_PIPELINE		(1UL << 9)
+#define CAPS_PAGE_COMPARE		(1UL << 10)
+#define CAPS_PAGE_ERASE_ELISION		(1UL << 11)
+#define CAPS_ERASED_PAGEMAP		(1UL << 12)
+#define CAPS_BACKGROUND_CHIPERASE	(1UL << 13)
+#define CAPS_EEPROM_QUEUE		(1UL << 14)
+#define CAPS_EEPROM_UPDATE		(1UL << 15)
+#define CAPS_CHIP_ERASE			(1UL << 16)
+#define CAPS_ONDEMAND_PAGEERASE		(1UL << 17)
+#define CAPS_CAN_EXIT			(1UL << 18)
+#define CAPS_EEPROM_PAGED_ACCESS	(1UL << 19)
+
+typedef struct caps {
+	uint8_t		version;
+	uint16_t	page_size;
+	uint32_t	features;
+	uint32_t	flash_size;
+	uint32_t	app_size;
+	uint16_t	eeprom_size;
+	uint8_t		lz_window_bits;
+	uint8_t		isp_batch_max;
+} caps_t;
+
+/*
+ * Decodes a USBASP_FUNC_GETCAPABILITIES reply of len bytes. Returns 0 if
+ * it describes the boot loader, -1 for a plain USBasp reply (caps is
+ * cleared then).
+ */
+extern int	caps_parse(const uint8_t *buf, int len, caps_t *caps);
+
+/* Prints caps, one line per field, and the names of the features */
+extern void	caps_print(FILE *f, const caps_t *caps);
+
+#endif /* __caps_h_included__ */
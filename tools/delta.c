@@ -0,0 +1,180 @@
+/* Name: delta.c
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Delta upload: the page digests of the device (USBASP_FUNC_GETPAGECRCS)
+ * are compared with the pages of the new image and only differing pages
+ * are programmed, with the same requests AVRDUDE uses for a USBasp, or
+ * compressed with USBASP_FUNC_WRITEFLASHLZ.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "delta.h"
+#include "memcrc.h"
+#include "lzss.h"
+
+static int setLongAddress(const delta_transport_t *t, uint32_t address)
+{
+	uint8_t res[4];
+
+	return t->control_in(t->ctx, USBASP_FUNC_SETLONGADDRESS, address & 0xffff, address >> 16, res, 4);
+}
+
+/* digests of count pages starting with page first */
+static int readDigests(const delta_transport_t *t, uint16_t *digest, uint32_t first, uint32_t count,
+		       uint16_t pagesize)
+{
+	uint32_t	n, i, address, max = t->max_transfer / 2;
+	uint8_t		*buf = malloc(2 * max);
+	int		rc = -1;
+
+	if (!buf)
+		return -1;
+	while (count) {
+		n = (count > max) ? max : count;
+		address = first * pagesize;
+		if (setLongAddress(t, address) < 0)
+			goto done;
+		if (t->control_in(t->ctx, USBASP_FUNC_GETPAGECRCS, address & 0xffff, 0, buf, 2 * n) != (int)(2 * n))
+			goto done;
+		for (i = 0; i < n; i++)
+			digest[first + i] = buf[2*i] | (buf[2*i + 1] << 8);
+		first += n;
+		count -= n;
+	}
+	rc = 0;
+
+done:
+	free(buf);
+	return rc;
+}
+
+/* the way AVRDUDE's usbasp_spi_paged_write() sends a page */
+static int writePage(const delta_transport_t *t, const uint8_t *data, uint32_t address, uint16_t pagesize)
+{
+	uint16_t	block = (pagesize > t->max_transfer) ? (pagesize / 2) : pagesize;
+	uint16_t	done, index;
+	uint8_t		flags = USBASP_BLOCKFLAG_FIRST;
+
+	for (done = 0; done < pagesize; done += block) {
+		if (done + block >= pagesize)
+			flags |= USBASP_BLOCKFLAG_LAST;
+		index = (pagesize & 0xff) | (((flags & 0x0f) | ((pagesize & 0xf00) >> 4)) << 8);
+		if (setLongAddress(t, address + done) < 0)
+			return -1;
+		if (t->control_out(t->ctx, USBASP_FUNC_WRITEFLASH, (address + done) & 0xffff, index,
+				   data + done, block) != block)
+			return -1;
+		flags = 0;
+	}
+	return 0;
+}
+
+/* a run of pages as one USBASP_FUNC_WRITEFLASHLZ stream, or page by page if that is shorter */
+static int writeRunLz(const delta_transport_t *t, const uint8_t *data, uint32_t address, uint32_t len,
+		      uint16_t pagesize, uint32_t *bytes)
+{
+	uint8_t		*buf = malloc(LZSS_BOUND(len));
+	size_t		n, done, block;
+	uint16_t	index;
+	int		rc = -1;
+
+	if (!buf || !(n = lzss_compress(data, len, buf, t->lz_window_bits)))
+		goto done;
+	if (n >= len) {
+		for (done = 0; done < len; done += pagesize)
+			if (writePage(t, data + done, address + done, pagesize) < 0)
+				goto done;
+		*bytes += len;
+		rc = 0;
+		goto done;
+	}
+	if (setLongAddress(t, address) < 0)
+		goto done;
+	for (done = 0; done < n; done += block) {
+		block = ((n - done) > t->max_transfer) ? t->max_transfer : (n - done);
+		index = ((done == 0) ? USBASP_LZFLAG_FIRST : 0) | ((done + block == n) ? USBASP_LZFLAG_LAST : 0) |
+			(t->lz_window_bits << USBASP_LZWINDOW_SHIFT);
+		if (t->control_out(t->ctx, USBASP_FUNC_WRITEFLASHLZ, address & 0xffff, index,
+				   buf + done, block) != (int)block)
+			goto done;
+	}
+	*bytes += n;
+	rc = 0;
+
+done:
+	free(buf);
+	return rc;
+}
+
+int delta_upload(const delta_transport_t *t, const uint8_t *image, const uint8_t *used,
+		 uint32_t size, uint16_t pagesize, int flags, delta_stats_t *stats)
+{
+	uint32_t	pages = size / pagesize;
+	uint16_t	*digest;
+	uint8_t		*send;
+	uint32_t	page, first, i;
+	int		rc = -1;
+
+	memset(stats, 0, sizeof(*stats));
+	digest	= calloc(pages, sizeof(*digest));
+	send	= calloc(pages, 1);
+	if (!digest || !send)
+		goto done;
+	if (!(flags & DELTA_FULL) && (readDigests(t, digest, 0, pages, pagesize) < 0))
+		goto done;
+
+	for (page = 0; page < pages; page++) {
+		for (i = page * pagesize; i < (page + 1) * pagesize; i++)
+			if (used[i]) break;
+		if (i == (page + 1) * pagesize)
+			continue;
+		stats->pages++;
+		if (!(flags & DELTA_FULL) && (memcrc(0xffff, image + page * pagesize, pagesize) == digest[page]))
+			continue;
+		send[page] = 1;
+		stats->written++;
+	}
+
+	/* consecutive pages are sent as one compressed stream */
+	for (page = 0; page < pages; page++) {
+		if (!send[page])
+			continue;
+		if (flags & DELTA_LZ) {
+			for (first = page; (page + 1 < pages) && send[page + 1]; page++)
+				;
+			if (writeRunLz(t, image + first * pagesize, first * pagesize,
+				       (page + 1 - first) * pagesize, pagesize, &stats->bytes) < 0)
+				goto done;
+		} else {
+			if (writePage(t, image + page * pagesize, page * pagesize, pagesize) < 0)
+				goto done;
+			stats->bytes += pagesize;
+		}
+	}
+
+	/* check the written pages */
+	for (page = 0; !(flags & DELTA_FULL) && (page < pages); page++) {
+		if (!send[page])
+			continue;
+		if (readDigests(t, digest, page, 1, pagesize) < 0)
+			goto done;
+		if (memcrc(0xffff, image + page * pagesize, pagesize) != digest[page]) {
+			fprintf(stderr, "page 0x%05lx does not verify\n", (unsigned long)(page * pagesize));
+			stats->failed++;
+		}
+	}
+	rc = 0;
+
+done:
+	free(digest);
+	free(send);
+	return rc;
+}
@@ -0,0 +1,70 @@
+/* Name: delta.h
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+#ifndef __delta_h_included__
+#define __delta_h_included__
+
+#include <stdint.h>
+
+/* requests of the boot loader (see firmware/main.c) */
+#define USBASP_FUNC_CONNECT		1
+#define USBASP_FUNC_DISCONNECT		2
+#define USBASP_FUNC_WRITEFLASH		6
+#define USBASP_FUNC_SETLONGADDRESS	9
+#define USBASP_FUNC_GETPAGECRCS		67
+#define USBASP_FUNC_WRITEFLASHLZ	68
+
+#define USBASP_BLOCKFLAG_FIRST		1
+#define USBASP_BLOCKFLAG_LAST		2
+
+#define USBASP_LZFLAG_FIRST		1	/* wIndex of USBASP_FUNC_WRITEFLASHLZ */
+#define USBASP_LZFLAG_LAST		2
+#define USBASP_LZWINDOW_SHIFT		8	/* window bits in the high byte of wIndex */
+
+#define USBASP_MAXTRANSFER		254	/* without long transfers */
+
+/*
+ * Control transfers to the boot loader, implemented by the caller
+ * (libusb in usbaspdelta.c). Both return the number of bytes
+ * transferred or a negative value on error. max_transfer is the largest
+ * transfer the boot loader accepts: 254, or more if it was built with
+ * CONFIG_USE__LONG_TRANSFERS. lz_window_bits is LZ_WINDOW_BITS of a boot
+ * loader built with CONFIG_USE__LZ_WRITE (see lzss.h).
+ */
+typedef struct delta_transport {
+	int	(*control_in)(void *ctx, uint8_t request, uint16_t value, uint16_t index,
+			      uint8_t *buf, uint16_t len);
+	int	(*control_out)(void *ctx, uint8_t request, uint16_t value, uint16_t index,
+			       const uint8_t *buf, uint16_t len);
+	void	*ctx;
+	uint16_t max_transfer;
+	uint8_t	lz_window_bits;
+} delta_transport_t;
+
+typedef struct delta_stats {
+	uint32_t	pages;		/* pages with data in the image */
+	uint32_t	written;	/* pages which differed and were sent */
+	uint32_t	failed;		/* pages with a wrong digest afterwards */
+	uint32_t	bytes;		/* flash data sent (compressed with DELTA_LZ) */
+} delta_stats_t;
+
+/* flags of delta_upload() */
+#define DELTA_FULL	1	/* send all used pages, the device has no page digests */
+#define DELTA_LZ	2	/* compress runs of pages (CONFIG_USE__LZ_WRITE), runs
+				   which do not shrink are sent uncompressed */
+
+/*
+ * Uploads the used pages of image[0..size) (unused bytes must be 0xff,
+ * size must be a multiple of pagesize), sending only those whose digest
+ * on the device differs, and checks the digests of the written pages
+ * afterwards (neither with DELTA_FULL).
+ * Returns 0 on success, -1 on a transfer error.
+ */
+extern int	delta_upload(const delta_transport_t *t, const uint8_t *image, const uint8_t *used,
+			     uint32_t size, uint16_t pagesize, int flags, delta_stats_t *stats);
+
+#endif /* __delta_h_included__ */
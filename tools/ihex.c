@@ -0,0 +1,93 @@
+/* Name: ihex.c
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "ihex.h"
+
+static int hexbyte(const char *s)
+{
+	int	i, v = 0;
+
+	for (i = 0; i < 2; i++) {
+		v <<= 4;
+		if (s[i] >= '0' && s[i] <= '9')		v |= s[i] - '0';
+		else if (s[i] >= 'a' && s[i] <= 'f')	v |= s[i] - 'a' + 10;
+		else if (s[i] >= 'A' && s[i] <= 'F')	v |= s[i] - 'A' + 10;
+		else return -1;
+	}
+	return v;
+}
+
+long ihex_read(const char *filename, uint8_t *image, uint8_t *used, uint32_t size)
+{
+	FILE		*f;
+	char		line[600];
+	uint8_t		rec[256+5];
+	uint32_t	base = 0, addr;
+	long		end = 0;
+	int		lineno = 0, n, i, v;
+	uint8_t		sum;
+
+	if (!(f = fopen(filename, "r"))) {
+		perror(filename);
+		return -1;
+	}
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		if (line[0] != ':')
+			continue;
+		n = hexbyte(line + 1);
+		if ((n < 0) || (strlen(line) < (size_t)(11 + 2*n)))
+			goto broken;
+		for (i = 0, sum = 0; i < n + 5; i++) {
+			if ((v = hexbyte(line + 1 + 2*i)) < 0)
+				goto broken;
+			rec[i] = v;
+			sum += v;
+		}
+		if (sum != 0)
+			goto broken;
+		addr = (rec[1] << 8) | rec[2];
+		switch (rec[3]) {
+		case 0x00:	/* data */
+			for (i = 0; i < n; i++) {
+				if (base + addr + i >= size) {
+					fprintf(stderr, "%s:%d: address 0x%lx exceeds memory size\n",
+						filename, lineno, (unsigned long)(base + addr + i));
+					fclose(f);
+					return -1;
+				}
+				image[base + addr + i] = rec[4 + i];
+				if (used)
+					used[base + addr + i] = 1;
+			}
+			if ((long)(base + addr + n) > end)
+				end = base + addr + n;
+			break;
+		case 0x01:	/* end of file */
+			fclose(f);
+			return end;
+		case 0x02:	/* extended segment address */
+			base = ((rec[4] << 8) | rec[5]) << 4;
+			break;
+		case 0x04:	/* extended linear address */
+			base = (uint32_t)((rec[4] << 8) | rec[5]) << 16;
+			break;
+		default:	/* start addresses are of no interest */
+			break;
+		}
+	}
+	fclose(f);
+	return end;
+
+broken:
+	fprintf(stderr, "%s:%d: malformed record\n", filename, lineno);
+	fclose(f);
+	return -1;
+}
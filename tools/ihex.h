@@ -0,0 +1,21 @@
+/* Name: ihex.h
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+#ifndef __ihex_h_included__
+#define __ihex_h_included__
+
+#include <stdint.h>
+
+/*
+ * Reads an Intel HEX file into "image" (size bytes, preset by caller).
+ * Every byte stored is also marked in "used" (may be NULL).
+ * Returns the highest address written plus one, or -1 on error
+ * (a message has been printed to stderr then).
+ */
+extern long	ihex_read(const char *filename, uint8_t *image, uint8_t *used, uint32_t size);
+
+#endif /* __ihex_h_included__ */
@@ -0,0 +1,77 @@
+/* Name: imagecrc.c
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Host side reference of the boot loader's checksum requests.
+ *
+ * Computes the CRC16-CCITT exactly like USBASP_FUNC_GETFLASHCRC and
+ * USBASP_FUNC_GETEEPROMCRC do on the device: avr-libc's
+ * _crc_ccitt_update() with start value 0xffff over the memory as it
+ * looks after programming the given Intel HEX file (bytes not covered
+ * by the file read as 0xff). Ranges longer than 64 KB are printed in
+ * 64 KB chunks, one line per request a host would issue.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+
+#include "ihex.h"
+#include "memcrc.h"
+
+#define MEMSIZE		0x40000UL	/* largest flash supported (ATmega2560) */
+
+static uint8_t		image[MEMSIZE];
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-e] file.hex [start [length]]\n"
+		"  -e  the file is an EEPROM image (only changes the output label)\n"
+		"  start and length default to the range covered by the file\n",
+		prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long	start = 0, length, n;
+	long		end;
+	int		eeprom = 0, opt;
+
+	while ((opt = getopt(argc, argv, "e")) != -1) {
+		switch (opt) {
+		case 'e': eeprom = 1;	break;
+		default:  usage(argv[0]);
+		}
+	}
+	if ((optind >= argc) || (argc - optind > 3))
+		usage(argv[0]);
+
+	memset(image, 0xff, sizeof(image));
+	if ((end = ihex_read(argv[optind], image, NULL, MEMSIZE)) < 0)
+		return 1;
+	if (argc - optind > 1)
+		start = strtoul(argv[optind + 1], NULL, 0);
+	length = (end > (long)start) ? (end - start) : 0;
+	if (argc - optind > 2)
+		length = strtoul(argv[optind + 2], NULL, 0);
+	if ((start >= MEMSIZE) || (length > MEMSIZE - start) || (length == 0)) {
+		fprintf(stderr, "%s: invalid range\n", argv[0]);
+		return 1;
+	}
+
+	while (length) {
+		n = (length > 0x10000UL) ? 0x10000UL : length;
+		printf("%s 0x%05lx..0x%05lx: crc 0x%04x\n", eeprom ? "eeprom" : "flash",
+			start, start + n - 1, memcrc(0xffff, image + start, n));
+		start	+= n;
+		length	-= n;
+	}
+	return 0;
+}
@@ -0,0 +1,143 @@
+/* Name: lzss.c
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Compressor for USBASP_FUNC_WRITEFLASHLZ, see lzss.h for the format.
+ * Candidates are found through hash chains over the first 3 bytes, the
+ * choice between them is greedy with one step of lazy matching.
+ */
+
+#include <stdlib.h>
+
+#include "lzss.h"
+
+#define HASH_SIZE	4096
+#define NIL		((size_t)-1)
+
+typedef struct matcher {
+	const uint8_t	*in;
+	size_t		len;
+	size_t		window, maxmatch;
+	size_t		head[HASH_SIZE];
+	size_t		*prev;		/* previous position with the same hash */
+	size_t		inserted;	/* positions below are in the chains */
+} matcher_t;
+
+static unsigned hash3(const uint8_t *p)
+{
+	return ((p[0] << 4) ^ (p[1] << 2) ^ p[2]) & (HASH_SIZE - 1);
+}
+
+static void insertUpTo(matcher_t *m, size_t pos)
+{
+	unsigned h;
+
+	for (; m->inserted < pos; m->inserted++) {
+		if (m->inserted + LZSS_MINMATCH > m->len)
+			continue;
+		h = hash3(m->in + m->inserted);
+		m->prev[m->inserted] = m->head[h];
+		m->head[h] = m->inserted;
+	}
+}
+
+/* longest match for in[pos..len), the distance is returned in *distance */
+static size_t longestMatch(matcher_t *m, size_t pos, size_t *distance)
+{
+	size_t	cand, n, best = 0, max = m->len - pos;
+
+	if (max < LZSS_MINMATCH)
+		return 0;
+	if (max > m->maxmatch)
+		max = m->maxmatch;
+	insertUpTo(m, pos);
+	for (cand = m->head[hash3(m->in + pos)]; (cand != NIL) && (pos - cand <= m->window); cand = m->prev[cand]) {
+		for (n = 0; (n < max) && (m->in[pos + n] == m->in[cand + n]); n++)
+			;
+		if (n > best) {
+			best = n;
+			*distance = pos - cand;
+			if (n == max)
+				break;
+		}
+	}
+	return best;
+}
+
+size_t lzss_compress(const uint8_t *in, size_t len, uint8_t *out, int bits)
+{
+	matcher_t	*m = malloc(sizeof(*m));
+	size_t		pos = 0, o = 0, flagPos = 0, n, d = 0, d2, code, i;
+	int		item = 8;
+
+	if (!m || !(m->prev = malloc((len + 1) * sizeof(size_t)))) {
+		free(m);
+		return 0;
+	}
+	m->in		= in;
+	m->len		= len;
+	m->window	= LZSS_WINDOW(bits);
+	m->maxmatch	= LZSS_MAXMATCH(bits);
+	m->inserted	= 0;
+	for (i = 0; i < HASH_SIZE; i++)
+		m->head[i] = NIL;
+
+	while (pos < len) {
+		if (item == 8) {
+			flagPos = o++;
+			out[flagPos] = 0;
+			item = 0;
+		}
+		n = longestMatch(m, pos, &d);
+		/* lazy matching: prefer a literal if the next position matches longer */
+		if ((n >= LZSS_MINMATCH) && (n < m->maxmatch) && (longestMatch(m, pos + 1, &d2) > n + 1))
+			n = 0;
+		if (n >= LZSS_MINMATCH) {
+			code = (d - 1) | ((n - LZSS_MINMATCH) << bits);
+			out[o++] = code & 0xff;
+			out[o++] = code >> 8;
+			pos += n;
+		} else {
+			out[flagPos] |= 1 << item;
+			out[o++] = in[pos++];
+		}
+		item++;
+	}
+	free(m->prev);
+	free(m);
+	return o;
+}
+
+long lzss_decompress(const uint8_t *in, size_t len, uint8_t *out, size_t size, int bits)
+{
+	size_t		i = 0, o = 0, d, n, code;
+	unsigned	flags = 1;
+
+	while (i < len) {
+		if (flags <= 1) {
+			flags = in[i++] | 0x100;
+		} else if (flags & 1) {
+			if (o >= size)
+				return -1;
+			out[o++] = in[i++];
+			flags >>= 1;
+		} else {
+			if (i + 2 > len)
+				return -1;
+			code = in[i] | (in[i + 1] << 8);
+			d = (code & (LZSS_WINDOW(bits) - 1)) + 1;
+			n = (code >> bits) + LZSS_MINMATCH;
+			i += 2;
+			if ((d > o) || (o + n > size))
+				return -1;
+			for (; n; n--, o++)
+				out[o] = out[o - d];
+			flags >>= 1;
+		}
+	}
+	return o;
+}
@@ -0,0 +1,49 @@
+/* Name: lzss.h
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+#ifndef __lzss_h_included__
+#define __lzss_h_included__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Stream format of USBASP_FUNC_WRITEFLASHLZ (decoded by lzDecode() in
+ * firmware/main.c):
+ *
+ * A flag byte announces the next 8 items, least significant bit first.
+ * A set bit stands for one literal byte. A cleared bit stands for a match
+ * of 2 bytes, little endian, holding distance - 1 in the low "bits" bits
+ * and length - 3 in the others. The match copies "length" bytes starting
+ * "distance" bytes back in the output; source and destination may
+ * overlap. The device keeps the last 1 << bits bytes of output
+ * (LZ_WINDOW_BITS of the boot loader, 8 to 12), and matches never reach
+ * back before the start of a stream.
+ */
+#define LZSS_MINBITS		8
+#define LZSS_MAXBITS		12
+#define LZSS_MINMATCH		3
+#define LZSS_WINDOW(bits)	(1UL << (bits))
+#define LZSS_MAXMATCH(bits)	(LZSS_MINMATCH + (1UL << (16 - (bits))) - 1)
+
+/* worst case size of the compressed stream for len bytes of input */
+#define LZSS_BOUND(len)		((len) + ((len) + 7) / 8)
+
+/*
+ * Compresses len bytes from in into out (LZSS_BOUND(len) bytes) for a
+ * window of 1 << bits bytes and returns the size of the stream, or 0 if
+ * out of memory.
+ */
+extern size_t	lzss_compress(const uint8_t *in, size_t len, uint8_t *out, int bits);
+
+/*
+ * Reference decoder, returns the number of bytes written to out (at most
+ * size) or -1 if the stream is corrupt.
+ */
+extern long	lzss_decompress(const uint8_t *in, size_t len, uint8_t *out, size_t size, int bits);
+
+#endif /* __lzss_h_included__ */
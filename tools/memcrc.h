@@ -0,0 +1,32 @@
+/* Name: memcrc.h
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+#ifndef __memcrc_h_included__
+#define __memcrc_h_included__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * Bit exact copy of avr-libc's _crc_ccitt_update() (polynomial 0x1021,
+ * processed LSB first), which the boot loader uses for its checksums.
+ */
+static inline uint16_t crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+	data ^= (uint8_t)crc;
+	data ^= (uint8_t)(data << 4);
+	return ((((uint16_t)data << 8) | (crc >> 8)) ^ (uint8_t)(data >> 4) ^ ((uint16_t)data << 3));
+}
+
+static inline uint16_t memcrc(uint16_t crc, const uint8_t *data, size_t len)
+{
+	while (len--)
+		crc = crc_ccitt_update(crc, *data++);
+	return crc;
+}
+
+#endif /* __memcrc_h_included__ */
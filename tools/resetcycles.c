@@ -0,0 +1,845 @@
+/* Name: resetcycles.c
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-18
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Cycles from reset to the application.
+ *
+ * Reads the output of "avr-objdump -d main.elf" and runs the boot loader
+ * from its reset vector: the registers, the status register, the stack
+ * pointer and the RAM are tracked with their values where known. I/O
+ * registers read unknown (the reset flags, the jumper, ...) and both
+ * ways of every branch or skip depending on them are followed. A path
+ * ends when it jumps or calls to address 0 (the application) or enables
+ * interrupts (the boot loader is running). Cycle counts are those of the
+ * classic AVR core, the reset vector being the first instruction counted.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <getopt.h>
+
+#define MAXINSN		16384
+#define MAXFORKS	16
+#define RAMSTART	0x60		/* below: registers and I/O, read as unknown */
+
+/* status register bits */
+#define SR_C	0x01
+#define SR_Z	0x02
+#define SR_N	0x04
+#define SR_V	0x08
+#define SR_S	0x10
+#define SR_H	0x20
+#define SR_T	0x40
+#define SR_I	0x80
+#define FLAG_NAMES	"cznvsht"	/* sec, clc, sez, ... in bit order */
+
+enum { RUN, APPLICATION, LOADER, FAILED };
+
+typedef struct insn {
+	unsigned long	addr;
+	unsigned	size;
+	char		mnem[8];
+	int		nops;
+	char		op[3][16];
+	long		target;		/* byte address of a jump or call, -1 if none */
+	const char	*sym;		/* preceding symbol */
+	unsigned long	symaddr;
+} insn_t;
+
+typedef struct state {
+	long		pc;		/* index into insn[] */
+	unsigned long	cycles, steps;
+	uint8_t		reg[32], known[32];
+	uint8_t		sreg, sknown;
+	uint16_t	sp;
+	int		spKnown;	/* bit 0: SPL written, bit 1: SPH */
+	uint8_t		mem[0x10000], mknown[0x10000];
+	int		force;		/* outcome of the next undecided condition, -1 to fork */
+	int		nforks;
+	long		fork[MAXFORKS];	/* undecided conditions on the way */
+	int		outcome[MAXFORKS];
+	const char	*why;		/* FAILED */
+} state_t;
+
+static insn_t		insn[MAXINSN];
+static int		ninsn;
+static int		pc3;		/* 3 byte return addresses */
+static unsigned long	maxSteps = 20000000;
+static int		maxPaths = 32;
+static state_t		**work;
+static int		nwork, dropped;
+
+/* ------------------------------------------------------------------------- */
+
+/* register operand, X, Y and Z give the low register of the pair */
+static int reg(const insn_t *p, int n)
+{
+	const char	*s = p->op[n];
+
+	if (s[0] == '-')
+		s++;
+	if (s[0] == 'r')
+		return atoi(s + 1);
+	if (s[0] >= 'X' && s[0] <= 'Z')
+		return 26 + 2 * (s[0] - 'X');
+	return -1;
+}
+
+static long num(const insn_t *p, int n)
+{
+	return strtol(p->op[n], NULL, 0);
+}
+
+static long findInsn(unsigned long addr)
+{
+	long	lo = 0, hi = ninsn - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (insn[mid].addr == addr)
+			return mid;
+		if (insn[mid].addr < addr)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return -1;
+}
+
+/* lines of avr-objdump -d: "00007000 <__vectors>:" and "7002:\t0c 94 ...\tjmp\t0x7068\t; 0x7068 <...>" */
+static int readDisassembly(FILE *f)
+{
+	static char	symbols[MAXINSN][48];
+	char		line[256], *s, *t, *c;
+	int		nsym = 0, text = 0, n, i;
+	const char	*sym = "?";
+	unsigned long	symaddr = 0, addr;
+	insn_t		*p;
+
+	while (fgets(line, sizeof(line), f)) {
+		if (!strncmp(line, "Disassembly of section ", 23)) {
+			text = !strncmp(line + 23, ".text", 5);
+			continue;
+		}
+		if (!text)
+			continue;
+		if (isxdigit((unsigned char)line[0]) && (s = strchr(line, '<')) && (t = strstr(s, ">:"))) {
+			if (nsym == MAXINSN)
+				continue;
+			*t = 0;
+			snprintf(symbols[nsym], sizeof(symbols[nsym]), "%s", s + 1);
+			sym = symbols[nsym++];
+			symaddr = strtoul(line, NULL, 16);
+			continue;
+		}
+		addr = strtoul(line, &s, 16);
+		if ((s == line) || (*s != ':') || !strchr(s, '\t'))
+			continue;
+		/* raw bytes, then mnemonic and operands, then an optional comment */
+		s = strchr(s, '\t') + 1;
+		for (n = 0; isxdigit((unsigned char)s[0]) && isxdigit((unsigned char)s[1]) && (s[2] == ' '); s += 3)
+			n++;
+		s += strspn(s, " \t");
+		if ((n < 2) || !*s || (*s == '.') || (*s == '\n'))
+			continue;			/* data (.word) or a continuation line */
+		if (ninsn == MAXINSN) {
+			fprintf(stderr, "resetcycles: too many instructions\n");
+			return -1;
+		}
+		p = &insn[ninsn];
+		memset(p, 0, sizeof(*p));
+		p->addr = addr;
+		p->size = n;
+		p->sym = sym;
+		p->symaddr = symaddr;
+		p->target = -1;
+		if ((c = strchr(s, ';')))
+			*c++ = 0;
+		n = strcspn(s, " \t\n");
+		snprintf(p->mnem, sizeof(p->mnem), "%.*s", n, s);
+		for (s += n, i = 0; i < 3; i++) {
+			s += strspn(s, " \t,\n");
+			if (!(n = strcspn(s, ", \t\n")))
+				break;
+			snprintf(p->op[i], sizeof(p->op[i]), "%.*s", n, s);
+			s += n;
+		}
+		p->nops = i;
+		/* avr-objdump shows lsl and rol as add and adc of a register with itself */
+		if ((!strcmp(p->mnem, "add") || !strcmp(p->mnem, "adc")) && (i == 2) && !strcmp(p->op[0], p->op[1])) {
+			strcpy(p->mnem, (p->mnem[2] == 'd') ? "lsl" : "rol");
+			p->nops = 1;
+		}
+		/* relative targets are resolved in the comment, ".+N" is relative to the next instruction */
+		if (!strcmp(p->mnem, "jmp") || !strcmp(p->mnem, "call"))
+			p->target = strtoul(p->op[0], NULL, 0);
+		else if (!strcmp(p->mnem, "rjmp") || !strcmp(p->mnem, "rcall") || (p->mnem[0] == 'b' && p->mnem[1] == 'r'))
+			p->target = c ? (long)strtoul(c + strspn(c, " "), NULL, 0) :
+				    (long)p->addr + 2 + strtol(p->op[p->nops - 1] + 1, NULL, 0);
+		if (addr >= 0x20000)
+			pc3 = 1;
+		ninsn++;
+	}
+	return ninsn ? 0 : -1;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static int fail(state_t *s, const char *why)
+{
+	s->why = why;
+	return FAILED;
+}
+
+static void setReg(state_t *s, int r, unsigned value, int known)
+{
+	s->reg[r] = known ? value : 0;
+	s->known[r] = known;
+}
+
+static void setFlags(state_t *s, unsigned mask, unsigned value)
+{
+	s->sreg = (s->sreg & ~mask) | (value & mask);
+	s->sknown |= mask;
+}
+
+static void forgetFlags(state_t *s, unsigned mask)
+{
+	s->sreg &= ~mask;
+	s->sknown &= ~mask;
+}
+
+/* Z, N and S of an 8 bit result, with V as given */
+static unsigned flagsOf(unsigned res, int v)
+{
+	unsigned	f = v ? SR_V : 0;
+
+	if (!(res & 0xff))
+		f |= SR_Z;
+	if (res & 0x80)
+		f |= SR_N;
+	if (!(f & SR_N) != !(f & SR_V))
+		f |= SR_S;
+	return f;
+}
+
+static int readMem(const state_t *s, unsigned addr, uint8_t *v)
+{
+	addr &= 0xffff;
+	if (addr < 0x20) {
+		*v = s->reg[addr];
+		return s->known[addr];
+	}
+	if (addr == 0x5d || addr == 0x5e) {
+		*v = (addr == 0x5d) ? (s->sp & 0xff) : (s->sp >> 8);
+		return (s->spKnown >> (addr - 0x5d)) & 1;
+	}
+	if (addr == 0x5f) {
+		*v = s->sreg;
+		return s->sknown == 0xff;
+	}
+	if (addr < RAMSTART)
+		return 0;
+	*v = s->mem[addr];
+	return s->mknown[addr];
+}
+
+static void writeMem(state_t *s, unsigned addr, uint8_t v, int known)
+{
+	addr &= 0xffff;
+	if (addr < 0x20) {
+		setReg(s, addr, v, known);
+	} else if (addr == 0x5d || addr == 0x5e) {
+		s->sp = (addr == 0x5d) ? ((s->sp & 0xff00) | v) : ((s->sp & 0xff) | (v << 8));
+		if (known)
+			s->spKnown |= 1 << (addr - 0x5d);
+		else
+			s->spKnown &= ~(1 << (addr - 0x5d));
+	} else if (addr == 0x5f) {
+		if (known)
+			setFlags(s, 0xff, v);
+		else
+			forgetFlags(s, 0xff);
+	} else if (addr >= RAMSTART) {
+		s->mem[addr] = known ? v : 0;
+		s->mknown[addr] = known;
+	}
+}
+
+static int push(state_t *s, unsigned v, int known)
+{
+	if (s->spKnown != 3)
+		return -1;
+	writeMem(s, s->sp--, v, known);
+	return 0;
+}
+
+static int pop(state_t *s, uint8_t *v)
+{
+	if (s->spKnown != 3)
+		return -1;
+	return readMem(s, ++s->sp, v);
+}
+
+/* return address pushed by a call; the stack pointer is needed before init2 sets it */
+static int pushReturn(state_t *s, unsigned long byteAddr)
+{
+	unsigned long	w = byteAddr / 2;
+
+	if (push(s, w, 1) < 0 || push(s, w >> 8, 1) < 0 || (pc3 && push(s, w >> 16, 1) < 0))
+		return -1;
+	return 0;
+}
+
+static long popReturn(state_t *s)
+{
+	unsigned long	w = 0;
+	uint8_t		v;
+	int		i;
+
+	for (i = pc3 ? 2 : 1; i >= 0; i--) {
+		if (pop(s, &v) <= 0)
+			return -1;
+		w |= (unsigned long)v << (8 * i);
+	}
+	return w * 2;
+}
+
+/* X, Y or Z with post-increment, pre-decrement or displacement ("Y+3") */
+static int pointer(state_t *s, const char *op, unsigned *addr)
+{
+	int		r = 26 + 2 * (op[op[0] == '-'] - 'X');
+	unsigned	v;
+
+	if (!s->known[r] || !s->known[r + 1])
+		return -1;
+	v = s->reg[r] | (s->reg[r + 1] << 8);
+	if (op[0] == '-')
+		v = (v - 1) & 0xffff;
+	*addr = (v + ((op[1] == '+' && op[2]) ? atoi(op + 2) : 0)) & 0xffff;
+	if (op[0] == '-')
+		setReg(s, r, v, 1), setReg(s, r + 1, v >> 8, 1);
+	else if (op[1] == '+' && !op[2])
+		setReg(s, r, v + 1, 1), setReg(s, r + 1, (v + 1) >> 8, 1);
+	return 0;
+}
+
+static void logic(state_t *s, const char *m, int d, unsigned b, int kb)
+{
+	unsigned	a = s->reg[d], res;
+	int		k = s->known[d] && kb;
+
+	if (!strcmp(m, "and") || !strcmp(m, "andi") || !strcmp(m, "cbr") || !strcmp(m, "tst")) {
+		if (!strcmp(m, "cbr"))
+			b = ~b;
+		res = a & b;
+		/* a known zero on either side decides */
+		if ((s->known[d] && !a) || (kb && !(b & 0xff)))
+			k = 1, res = 0;
+	} else if (!strcmp(m, "eor")) {
+		res = a ^ b;
+	} else if (!strcmp(m, "com")) {
+		res = ~a;
+		k = s->known[d];
+	} else {
+		res = a | b;
+	}
+	if (!strcmp(m, "com"))
+		setFlags(s, SR_C, SR_C);
+	setFlags(s, SR_V, 0);
+	if (strcmp(m, "tst"))
+		setReg(s, d, res & 0xff, k);
+	if (k)
+		setFlags(s, SR_Z | SR_N | SR_S, flagsOf(res, 0));
+	else
+		forgetFlags(s, SR_Z | SR_N | SR_S);
+}
+
+static void arith(state_t *s, const char *m, int d, unsigned b, int kb)
+{
+	unsigned	a = s->reg[d], c = s->sreg & SR_C, res, f;
+	int		sub = (m[0] == 's' || m[0] == 'c' || m[0] == 'n');
+	int		carry = !strcmp(m, "adc") || !strcmp(m, "rol") || !strcmp(m, "sbc") ||
+				!strcmp(m, "sbci") || !strcmp(m, "cpc");
+	int		write = (m[0] != 'c'), known;
+
+	if (!strcmp(m, "neg"))
+		b = a, a = 0;
+	known = s->known[d] && kb && (!carry || ((s->sknown & (SR_C | SR_Z)) == (SR_C | SR_Z)));
+	if (!known) {
+		forgetFlags(s, SR_C | SR_Z | SR_N | SR_V | SR_S | SR_H);
+		if (write)
+			setReg(s, d, 0, 0);
+		return;
+	}
+	if (!carry)
+		c = 0;
+	if (sub) {
+		res = (a - b - c) & 0x1ff;
+		f = flagsOf(res, ((a ^ b) & (a ^ res) & 0x80) != 0);
+		if (b + c > a)
+			f |= SR_C;
+		if ((b & 0xf) + c > (a & 0xf))
+			f |= SR_H;
+		if (!strcmp(m, "neg"))
+			f = (f & ~SR_C) | ((res & 0xff) ? SR_C : 0);
+	} else {
+		res = a + b + c;
+		f = flagsOf(res, ((a ^ res) & (b ^ res) & 0x80) != 0);
+		if (res & 0x100)
+			f |= SR_C;
+		if (((a & 0xf) + (b & 0xf) + c) & 0x10)
+			f |= SR_H;
+	}
+	/* sbc, sbci and cpc only clear Z */
+	if (carry && sub && !(s->sreg & SR_Z))
+		f &= ~SR_Z;
+	if (write)
+		setReg(s, d, res & 0xff, 1);
+	setFlags(s, SR_C | SR_Z | SR_N | SR_V | SR_S | SR_H, f);
+}
+
+static void shift(state_t *s, const char *m, int d)
+{
+	unsigned	a = s->reg[d], res, cout;
+	int		k = s->known[d] && (!strcmp(m, "lsr") || !strcmp(m, "asr") || (s->sknown & SR_C));
+
+	if (!strcmp(m, "lsl") || !strcmp(m, "rol")) {
+		arith(s, (m[0] == 'l') ? "add" : "adc", d, a, s->known[d]);
+		return;
+	}
+	if (!k) {
+		setReg(s, d, 0, 0);
+		forgetFlags(s, SR_C | SR_Z | SR_N | SR_V | SR_S);
+		return;
+	}
+	res = a >> 1;
+	if (!strcmp(m, "ror"))
+		res |= (s->sreg & SR_C) ? 0x80 : 0;
+	else if (!strcmp(m, "asr"))
+		res |= a & 0x80;
+	cout = a & 1;
+	setReg(s, d, res, 1);
+	/* V = N ^ C, S = N ^ V */
+	setFlags(s, SR_C | SR_Z | SR_N | SR_V | SR_S,
+		 (flagsOf(res, !(res & 0x80) != !cout) & ~SR_C) | (cout ? SR_C : 0));
+}
+
+/* the flag a conditional branch tests, set tells whether it branches if the flag is set */
+static unsigned branchFlag(const insn_t *p, int *set)
+{
+	static const struct { const char *name; unsigned flag; int set; } br[] = {
+		{ "brcs", SR_C, 1 }, { "brlo", SR_C, 1 }, { "brcc", SR_C, 0 }, { "brsh", SR_C, 0 },
+		{ "breq", SR_Z, 1 }, { "brne", SR_Z, 0 }, { "brmi", SR_N, 1 }, { "brpl", SR_N, 0 },
+		{ "brvs", SR_V, 1 }, { "brvc", SR_V, 0 }, { "brlt", SR_S, 1 }, { "brge", SR_S, 0 },
+		{ "brhs", SR_H, 1 }, { "brhc", SR_H, 0 }, { "brts", SR_T, 1 }, { "brtc", SR_T, 0 },
+		{ "brie", SR_I, 1 }, { "brid", SR_I, 0 }, { NULL, 0, 0 }
+	};
+	int	i;
+
+	if (!strcmp(p->mnem, "brbs") || !strcmp(p->mnem, "brbc")) {
+		*set = (p->mnem[3] == 's');
+		return 1 << num(p, 0);
+	}
+	for (i = 0; br[i].name; i++) {
+		if (!strcmp(p->mnem, br[i].name)) {
+			*set = br[i].set;
+			return br[i].flag;
+		}
+	}
+	return 0;
+}
+
+/* outcome of a branch or skip condition: 1, 0 or -1 if unknown */
+static int condition(const state_t *s, const insn_t *p)
+{
+	const char	*m = p->mnem;
+	int		set, d = reg(p, 0), r = reg(p, 1);
+	unsigned	flag = branchFlag(p, &set), bit;
+
+	if (flag)
+		return (s->sknown & flag) ? (((s->sreg & flag) != 0) == set) : -1;
+	if (!strcmp(m, "sbrc") || !strcmp(m, "sbrs")) {
+		bit = 1 << num(p, 1);
+		return s->known[d] ? (((s->reg[d] & bit) != 0) == (m[3] == 's')) : -1;
+	}
+	if (!strcmp(m, "cpse"))
+		return (s->known[d] && s->known[r]) ? (s->reg[d] == s->reg[r]) : -1;
+	return -1;			/* sbis, sbic: port input */
+}
+
+/* decides an unknown condition: the path goes on with 0, a copy of it with 1 */
+static int decide(state_t *s, int c)
+{
+	state_t	*copy;
+
+	if (c >= 0)
+		return c;
+	if (s->force >= 0) {
+		c = s->force;
+		s->force = -1;
+	} else {
+		c = 0;
+		if (nwork < maxPaths && (copy = malloc(sizeof(*copy)))) {
+			/* the copy runs this instruction again */
+			*copy = *s;
+			copy->force = 1;
+			copy->cycles--;
+			copy->steps--;
+			work[nwork++] = copy;
+		} else {
+			dropped = 1;
+		}
+	}
+	if (s->nforks < MAXFORKS) {
+		s->fork[s->nforks] = s->pc;
+		s->outcome[s->nforks++] = c;
+	}
+	return c;
+}
+
+/* continues at byte address addr */
+static int jump(state_t *s, unsigned long addr)
+{
+	if (addr == 0)
+		return APPLICATION;
+	if ((s->pc = findInsn(addr)) < 0)
+		return fail(s, "jump outside the listing");
+	return RUN;
+}
+
+/* runs one instruction of s */
+static int step(state_t *s)
+{
+	const insn_t	*p = &insn[s->pc];
+	const char	*m = p->mnem;
+	int		d = (p->nops > 0) ? reg(p, 0) : -1, r = (p->nops > 1) ? reg(p, 1) : -1, c, i, set;
+	unsigned	b = ((p->nops > 1) && (r < 0)) ? (unsigned)num(p, 1) & 0xff : 0, addr, w;
+	unsigned long	next = p->addr + p->size;
+	long		ret;
+	uint8_t		v;
+
+	s->steps++;
+	s->cycles++;
+	if (r >= 0)
+		b = s->reg[r];
+
+	/* control flow */
+	if (!strcmp(m, "rjmp") || !strcmp(m, "jmp")) {
+		s->cycles += (m[0] == 'j') ? 2 : 1;
+		return jump(s, p->target);
+	}
+	if (!strcmp(m, "rcall") || !strcmp(m, "call") || !strcmp(m, "icall") || !strcmp(m, "eicall")) {
+		s->cycles += ((m[0] == 'c') ? 3 : 2) + pc3;
+		if (m[0] == 'e' || m[0] == 'i') {
+			if (!s->known[30] || !s->known[31])
+				return fail(s, "indirect call through an unknown Z");
+			w = (s->reg[30] | (s->reg[31] << 8)) * 2;
+		} else {
+			w = p->target;
+		}
+		if (w == 0)
+			return APPLICATION;
+		if (pushReturn(s, next) < 0)
+			return fail(s, "call with an unknown stack pointer");
+		return jump(s, w);
+	}
+	if (!strcmp(m, "ijmp") || !strcmp(m, "eijmp")) {
+		s->cycles += 1;
+		if (!s->known[30] || !s->known[31])
+			return fail(s, "indirect jump through an unknown Z");
+		return jump(s, (s->reg[30] | (s->reg[31] << 8)) * 2UL);
+	}
+	if (!strcmp(m, "ret") || !strcmp(m, "reti")) {
+		s->cycles += 3 + pc3;
+		if ((ret = popReturn(s)) < 0)
+			return fail(s, "return to an unknown address");
+		if (m[3] == 'i')
+			return LOADER;
+		return jump(s, ret);
+	}
+	if (branchFlag(p, &set)) {
+		if (decide(s, condition(s, p))) {
+			s->cycles++;
+			return jump(s, p->target);
+		}
+		s->pc++;
+		return RUN;
+	}
+	if (!strcmp(m, "cpse") || !strcmp(m, "sbrc") || !strcmp(m, "sbrs") || !strcmp(m, "sbic") || !strcmp(m, "sbis")) {
+		c = decide(s, condition(s, p));
+		s->pc++;
+		if (c && s->pc < ninsn) {
+			s->cycles += insn[s->pc].size / 2;
+			s->pc++;
+		}
+		return RUN;
+	}
+	if (!strcmp(m, "sei"))
+		return LOADER;
+
+	/* registers, flags and memory */
+	if (!strcmp(m, "ldi") || !strcmp(m, "ser")) {
+		setReg(s, d, (m[0] == 's') ? 0xff : b, 1);
+	} else if (!strcmp(m, "mov") || !strcmp(m, "movw")) {
+		for (i = 0; i < ((m[3] == 'w') ? 2 : 1); i++)
+			setReg(s, d + i, s->reg[r + i], s->known[r + i]);
+	} else if (!strcmp(m, "clr")) {
+		setReg(s, d, 0, 1);
+		setFlags(s, SR_Z | SR_N | SR_V | SR_S, SR_Z);
+	} else if (!strcmp(m, "and") || !strcmp(m, "andi") || !strcmp(m, "cbr") || !strcmp(m, "or") ||
+		   !strcmp(m, "ori") || !strcmp(m, "sbr") || !strcmp(m, "eor") || !strcmp(m, "com")) {
+		if (!strcmp(m, "eor") && r == d)
+			setReg(s, d, 0, 1), b = 0;
+		logic(s, m, d, b, (r < 0) || s->known[r]);
+	} else if (!strcmp(m, "tst")) {
+		logic(s, m, d, s->reg[d], s->known[d]);
+	} else if (!strcmp(m, "add") || !strcmp(m, "adc") || !strcmp(m, "sub") || !strcmp(m, "subi") ||
+		   !strcmp(m, "sbc") || !strcmp(m, "sbci") || !strcmp(m, "cp") || !strcmp(m, "cpc") ||
+		   !strcmp(m, "cpi") || !strcmp(m, "neg")) {
+		if (!strcmp(m, "sub") && r == d)
+			setReg(s, d, 0, 1);
+		arith(s, m, d, b, (r < 0) || s->known[r]);
+	} else if (!strcmp(m, "inc") || !strcmp(m, "dec")) {
+		if (s->known[d]) {
+			b = (s->reg[d] + ((m[0] == 'i') ? 1 : 0xff)) & 0xff;
+			setReg(s, d, b, 1);
+			setFlags(s, SR_Z | SR_N | SR_V | SR_S, flagsOf(b, b == ((m[0] == 'i') ? 0x80 : 0x7f)));
+		} else {
+			forgetFlags(s, SR_Z | SR_N | SR_V | SR_S);
+		}
+	} else if (!strcmp(m, "lsl") || !strcmp(m, "rol") || !strcmp(m, "lsr") || !strcmp(m, "ror") ||
+		   !strcmp(m, "asr")) {
+		shift(s, m, d);
+	} else if (!strcmp(m, "swap")) {
+		setReg(s, d, (s->reg[d] << 4) | (s->reg[d] >> 4), s->known[d]);
+	} else if (!strcmp(m, "bst")) {
+		if (s->known[d])
+			setFlags(s, SR_T, (s->reg[d] & (1 << num(p, 1))) ? SR_T : 0);
+		else
+			forgetFlags(s, SR_T);
+	} else if (!strcmp(m, "bld")) {
+		w = 1 << num(p, 1);
+		setReg(s, d, (s->reg[d] & ~w) | ((s->sreg & SR_T) ? w : 0), s->known[d] && (s->sknown & SR_T));
+	} else if (!strcmp(m, "adiw") || !strcmp(m, "sbiw")) {
+		s->cycles++;
+		if (s->known[d] && s->known[d + 1]) {
+			w = s->reg[d] | (s->reg[d + 1] << 8);
+			addr = (m[0] == 'a') ? w + b : w - b;
+			setReg(s, d, addr & 0xff, 1);
+			setReg(s, d + 1, (addr >> 8) & 0xff, 1);
+			setFlags(s, SR_C | SR_Z | SR_N | SR_V | SR_S,
+				 (!(addr & 0xffff) ? SR_Z : 0) | ((addr & 0x8000) ? SR_N : 0) |
+				 ((m[0] == 'a') ? ((addr & 0x10000) ? SR_C : 0) : ((b > w) ? SR_C : 0)) |
+				 ((((m[0] == 'a') ? (~w & addr) : (w & ~addr)) & 0x8000) ? SR_V : 0));
+			if (!(s->sreg & SR_N) != !(s->sreg & SR_V))
+				s->sreg |= SR_S;
+			else
+				s->sreg &= ~SR_S;
+		} else {
+			setReg(s, d, 0, 0);
+			setReg(s, d + 1, 0, 0);
+			forgetFlags(s, SR_C | SR_Z | SR_N | SR_V | SR_S);
+		}
+	} else if (!strcmp(m, "mul") || !strcmp(m, "muls") || !strcmp(m, "mulsu") || !strncmp(m, "fmul", 4)) {
+		s->cycles++;
+		setReg(s, 0, 0, 0);
+		setReg(s, 1, 0, 0);
+		forgetFlags(s, SR_C | SR_Z);
+	} else if ((strlen(m) == 3) && (!strncmp(m, "se", 2) || !strncmp(m, "cl", 2)) && strchr(FLAG_NAMES, m[2])) {
+		/* sec, clc, set, clt, ... */
+		setFlags(s, 1 << (strchr(FLAG_NAMES, m[2]) - FLAG_NAMES), (m[0] == 's') ? 0xff : 0);
+	} else if (!strcmp(m, "cli")) {
+		setFlags(s, SR_I, 0);
+	} else if (!strcmp(m, "in")) {
+		c = readMem(s, num(p, 1) + 0x20, &v);
+		setReg(s, d, v, c);
+	} else if (!strcmp(m, "out")) {
+		writeMem(s, num(p, 0) + 0x20, s->reg[r], s->known[r]);
+	} else if (!strcmp(m, "sbi") || !strcmp(m, "cbi")) {
+		s->cycles++;
+	} else if (!strcmp(m, "lds") || !strcmp(m, "sts")) {
+		s->cycles++;
+		if (m[0] == 'l') {
+			c = readMem(s, num(p, 1), &v);
+			setReg(s, d, v, c);
+		} else {
+			r = reg(p, 1);
+			writeMem(s, num(p, 0), s->reg[r], s->known[r]);
+		}
+	} else if (!strcmp(m, "ld") || !strcmp(m, "ldd")) {
+		s->cycles += (p->op[1][0] == '-') ? 2 : 1;
+		if (pointer(s, p->op[1], &addr) < 0) {
+			/* unknown address: the register and a changed pointer are unknown */
+			setReg(s, d, 0, 0);
+			if (p->op[1][0] == '-' || (p->op[1][1] == '+' && !p->op[1][2]))
+				setReg(s, reg(p, 1), 0, 0), setReg(s, reg(p, 1) + 1, 0, 0);
+		} else {
+			c = readMem(s, addr, &v);
+			setReg(s, d, v, c);
+		}
+	} else if (!strcmp(m, "st") || !strcmp(m, "std")) {
+		s->cycles++;
+		r = reg(p, 1);
+		b = s->reg[r];
+		c = s->known[r];
+		if (pointer(s, p->op[0], &addr) < 0)
+			return fail(s, "store through an unknown pointer");
+		writeMem(s, addr, b, c);
+	} else if (!strcmp(m, "push")) {
+		s->cycles++;
+		if (push(s, s->reg[d], s->known[d]) < 0)
+			return fail(s, "push with an unknown stack pointer");
+	} else if (!strcmp(m, "pop")) {
+		s->cycles++;
+		if ((c = pop(s, &v)) < 0)
+			return fail(s, "pop with an unknown stack pointer");
+		setReg(s, d, v, c);
+	} else if (!strcmp(m, "lpm") || !strcmp(m, "elpm")) {
+		/* flash contents are not in the listing */
+		s->cycles += 2;
+		setReg(s, (p->nops == 0) ? 0 : d, 0, 0);
+		if (p->nops > 1 && p->op[1][1] == '+') {
+			if (s->known[30] && s->known[31] && s->reg[30]++ == 0xff)
+				s->reg[31]++;
+		}
+	} else if (strcmp(m, "nop") && strcmp(m, "wdr")) {
+		return fail(s, "unsupported instruction");
+	}
+	s->pc++;
+	if (s->pc >= ninsn || insn[s->pc].addr != next)
+		return fail(s, "ran off the listing");
+	return RUN;
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void printInsn(long i)
+{
+	const insn_t	*p = &insn[i];
+	int		n;
+
+	printf("%lx <%s+0x%lx> %s", p->addr, p->sym, p->addr - p->symaddr, p->mnem);
+	for (n = 0; n < p->nops; n++)
+		printf("%s%s", n ? ", " : " ", p->op[n]);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-v] [-3] [-k khz] [-e symbol] [-n paths] [-s steps] [file]\n"
+		"  reads \"avr-objdump -d main.elf\" from file or stdin\n"
+		"  -k khz     F_CPU / 1000, to show the time as well\n"
+		"  -e symbol  reset vector, default the first instruction\n"
+		"  -3         3 byte program counter (default: if the listing is above 128 kB)\n"
+		"  -n paths   paths followed at most, default %d\n"
+		"  -s steps   instructions per path at most, default %lu\n"
+		"  -v         list the undecided conditions of each path\n",
+		prog, maxPaths, maxSteps);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	static const char	*endNames[] = { "", "application", "boot loader", "not followed" };
+	const char		*entry = NULL;
+	FILE			*f = stdin;
+	int			opt, i, verbose = 0, paths = 0, apps = 0, end;
+	long			khz = 0;
+	unsigned long		minApp = ~0UL, maxApp = 0;
+	state_t			*s;
+
+	while ((opt = getopt(argc, argv, "v3k:e:n:s:")) != -1) {
+		switch (opt) {
+		case 'v': verbose = 1;				break;
+		case '3': pc3 = 1;				break;
+		case 'k': khz = strtol(optarg, NULL, 0);	break;
+		case 'e': entry = optarg;			break;
+		case 'n': maxPaths = atoi(optarg);		break;
+		case 's': maxSteps = strtoul(optarg, NULL, 0);	break;
+		default:  usage(argv[0]);
+		}
+	}
+	if ((khz < 0) || (maxPaths < 1) || (argc - optind > 1))
+		usage(argv[0]);
+	if ((optind < argc) && !(f = fopen(argv[optind], "r"))) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if (readDisassembly(f) < 0) {
+		fprintf(stderr, "resetcycles: no instructions found\n");
+		return 1;
+	}
+	for (i = 0; entry && (i < ninsn); i++)
+		if (!strcmp(insn[i].sym, entry) && (insn[i].addr == insn[i].symaddr))
+			break;
+	if (i == ninsn) {
+		fprintf(stderr, "resetcycles: symbol %s not found\n", entry);
+		return 1;
+	}
+
+	work = malloc(maxPaths * sizeof(*work));
+	if (!work || !(s = calloc(1, sizeof(*s)))) {
+		fprintf(stderr, "resetcycles: out of memory\n");
+		return 1;
+	}
+	s->pc = entry ? i : 0;
+	s->force = -1;
+	/* SREG is cleared by reset, the stack pointer is not set up yet on all devices */
+	s->sknown = 0xff;
+	work[nwork++] = s;
+	printf("reset vector 0x%lx, %d byte program counter\n", insn[s->pc].addr, pc3 ? 3 : 2);
+
+	/* the first path not decided by a condition is finished first, then its forks */
+	for (i = 0; i < nwork; i++) {
+		s = work[i];
+		do
+			end = (s->steps < maxSteps) ? step(s) : fail(s, "too many instructions");
+		while (end == RUN);
+		paths++;
+		printf("%-12s after %9lu cycles", endNames[end], s->cycles);
+		if (khz)
+			printf(" (%10.2f us)", s->cycles * 1000.0 / khz);
+		if (end == FAILED) {
+			printf(": %s at ", s->why);
+			printInsn(s->pc);
+		}
+		printf("\n");
+		if (verbose) {
+			for (opt = 0; opt < s->nforks; opt++) {
+				printf("    ");
+				printInsn(s->fork[opt]);
+				if (insn[s->fork[opt]].mnem[0] == 'b')
+					printf(": %s\n", s->outcome[opt] ? "taken" : "not taken");
+				else
+					printf(": %s\n", s->outcome[opt] ? "skip" : "no skip");
+			}
+		}
+		if (end == APPLICATION) {
+			apps++;
+			if (s->cycles < minApp)
+				minApp = s->cycles;
+			if (s->cycles > maxApp)
+				maxApp = s->cycles;
+		}
+		free(s);
+	}
+	if (dropped)
+		printf("more paths not followed, see -n\n");
+	if (!apps) {
+		printf("no path to the application\n");
+		return 1;
+	}
+	printf("reset to application: %lu to %lu cycles", minApp, maxApp);
+	if (khz)
+		printf(" (%.2f to %.2f us)", minApp * 1000.0 / khz, maxApp * 1000.0 / khz);
+	printf(", %d of %d paths\n", apps, paths);
+	return 0;
+}
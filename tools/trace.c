@@ -0,0 +1,92 @@
+/* Name: trace.c
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-18
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Decoder of the boot loader's event trace (USBASP_FUNC_GETTRACE), used
+ * by usbasptrace.c and the hostsim build.
+ */
+
+#include <stdio.h>
+
+#include "trace.h"
+
+typedef struct phase {
+	const char	*name;
+	uint8_t		from, to;	/* events starting and ending it */
+	uint32_t	count;
+	uint64_t	sum, max;	/* ticks */
+} phase_t;
+
+static const char *eventName(uint8_t event)
+{
+	switch (event) {
+	case TRACE_SETUP:	return "setup";
+	case TRACE_FILL:	return "fill";
+	case TRACE_ERASE:	return "erase";
+	case TRACE_WRITE:	return "write";
+	case TRACE_FILLED:	return "filled";
+	case TRACE_RWWENABLE:	return "rww enable";
+	case TRACE_SKIP:	return "skip";
+	default:		return "?";
+	}
+}
+
+int trace_print(FILE *f, const uint8_t *buf, int len, unsigned long khz)
+{
+	phase_t		phases[] = {
+		{ "fill",	TRACE_FILL,	TRACE_FILLED, 0, 0, 0 },
+		{ "erase",	TRACE_ERASE,	TRACE_WRITE, 0, 0, 0 },
+		{ "write",	TRACE_WRITE,	TRACE_RWWENABLE, 0, 0, 0 },
+	};
+	uint64_t	start[3], now = 0;
+	uint8_t		startPage[3], startValid[3] = { 0, 0, 0 };
+	double		usPerTick = (double)TRACE_PRESCALER * 1000.0 / (double)khz;
+	uint16_t	last = 0, time;
+	int		next, entries, i, p, n = 0;
+	const uint8_t	*e;
+
+	if ((len < 2) || (buf[1] == 0) || (buf[0] >= buf[1]) || (len < 2 + 4 * buf[1]))
+		return -1;
+	next	= buf[0];
+	entries	= buf[1];
+	for (i = 0; i < entries; i++) {
+		e = buf + 2 + 4 * ((next + i) % entries);
+		if (e[0] == TRACE_UNUSED)
+			continue;
+		time = e[2] | (e[3] << 8);
+		if (n)
+			now += (uint16_t)(time - last);
+		last = time;
+		n++;
+		fprintf(f, "%12.1f us  %-10s  %s %3u\n", now * usPerTick, eventName(e[0]),
+			(e[0] == TRACE_SETUP) ? "request" : "page", e[1]);
+
+		for (p = 0; p < 3; p++) {
+			if ((e[0] == phases[p].to) && startValid[p] && (startPage[p] == e[1])) {
+				phases[p].count++;
+				phases[p].sum += now - start[p];
+				if (now - start[p] > phases[p].max)
+					phases[p].max = now - start[p];
+				startValid[p] = 0;
+			}
+			if (e[0] == phases[p].from) {
+				start[p]	= now;
+				startPage[p]	= e[1];
+				startValid[p]	= 1;
+			}
+		}
+	}
+
+	for (p = 0; p < 3; p++) {
+		if (!phases[p].count)
+			continue;
+		fprintf(f, "%-6s %4lu pages, %8.1f us average, %8.1f us max\n", phases[p].name,
+			(unsigned long)phases[p].count, phases[p].sum * usPerTick / phases[p].count,
+			phases[p].max * usPerTick);
+	}
+	return n;
+}
@@ -0,0 +1,46 @@
+/* Name: trace.h
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-18
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+#ifndef __trace_h_included__
+#define __trace_h_included__
+
+#include <stdio.h>
+#include <stdint.h>
+
+/*
+ * Reply of USBASP_FUNC_GETTRACE (boot loader built with CONFIG_USE__TRACE):
+ *
+ *   byte 0      index of the next entry to be written (the oldest one)
+ *   byte 1      number of entries (TRACE_ENTRIES of the boot loader)
+ *   byte 2...   entries of 4 bytes: event, data, timer 1 count (16 bit,
+ *               little endian, F_CPU / TRACE_PRESCALER)
+ *
+ * Unused entries have the event 0xff. The timer wraps after 65536 ticks
+ * (262 ms at 16 MHz), longer gaps between two events are not visible.
+ */
+#define USBASP_FUNC_GETTRACE		71
+
+#define TRACE_PRESCALER			64
+
+#define TRACE_SETUP			0x30	/* data: bRequest */
+#define TRACE_FILL			0x32	/* data of these: page number (low 8 bits) */
+#define TRACE_ERASE			0x33
+#define TRACE_WRITE			0x34
+#define TRACE_FILLED			0x35
+#define TRACE_RWWENABLE			0x36
+#define TRACE_SKIP			0x37
+#define TRACE_UNUSED			0xff
+
+/*
+ * Prints the events of a USBASP_FUNC_GETTRACE reply of len bytes, oldest
+ * first, in microseconds for a clock of khz, followed by the durations of
+ * page fill, erase and write. Returns the number of events, -1 if the
+ * reply is malformed.
+ */
+extern int	trace_print(FILE *f, const uint8_t *buf, int len, unsigned long khz);
+
+#endif /* __trace_h_included__ */
@@ -0,0 +1,143 @@
+/* Name: usbaspdelta.c
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-17
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Delta uploader for USBaspLoader built with CONFIG_USE__PAGE_DIGESTS:
+ * only pages differing from the flash contents are sent (see delta.c),
+ * optionally compressed for CONFIG_USE__LZ_WRITE. A boot loader built with
+ * CONFIG_USE__CAPABILITIES describes itself, the options below are only
+ * needed for other builds. Needs libusb-1.0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <getopt.h>
+#include <libusb.h>
+
+#include "ihex.h"
+#include "delta.h"
+#include "lzss.h"
+#include "caps.h"
+
+#define USBASP_VID	0x16c0
+#define USBASP_PID	0x05dc
+#define TIMEOUT_MS	5000
+
+static int controlIn(void *ctx, uint8_t request, uint16_t value, uint16_t index, uint8_t *buf, uint16_t len)
+{
+	return libusb_control_transfer(ctx, LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE | LIBUSB_ENDPOINT_IN,
+				       request, value, index, buf, len, TIMEOUT_MS);
+}
+
+static int controlOut(void *ctx, uint8_t request, uint16_t value, uint16_t index, const uint8_t *buf, uint16_t len)
+{
+	return libusb_control_transfer(ctx, LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE | LIBUSB_ENDPOINT_OUT,
+				       request, value, index, (uint8_t *)buf, len, TIMEOUT_MS);
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-lf] [-z bits] [-s pagesize -n appsize] file.hex\n"
+		"  -l           boot loader supports long transfers (CONFIG_USE__LONG_TRANSFERS)\n"
+		"  -f           send all pages, boot loader has no page digests\n"
+		"  -z bits      send compressed data (CONFIG_USE__LZ_WRITE), bits is the\n"
+		"               LZ_WINDOW_BITS of the boot loader: 11 with 4 kBytes of RAM\n"
+		"               or more, 10 with 2 kBytes, 8 otherwise\n"
+		"  -s pagesize  flash page size of the device in bytes (SPM_PAGESIZE)\n"
+		"  -n appsize   size of the application section (BOOTLOADER_ADDRESS)\n"
+		"These are taken from the boot loader if it answers USBASP_FUNC_GETCAPABILITIES.\n",
+		prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	libusb_device_handle	*handle;
+	delta_transport_t	t;
+	delta_stats_t		stats;
+	caps_t			caps;
+	uint8_t			*image, *used, dummy[4], capsBuf[CAPS_SIZE];
+	unsigned long		pagesize = 0, appsize = 0;
+	long			end;
+	int			opt, rc, longTransfers = 0, flags = 0, lzBits = 0;
+
+	while ((opt = getopt(argc, argv, "lfz:s:n:")) != -1) {
+		switch (opt) {
+		case 'l': longTransfers = 1;				break;
+		case 'f': flags |= DELTA_FULL;				break;
+		case 'z': flags |= DELTA_LZ;
+			  lzBits = strtol(optarg, NULL, 0);		break;
+		case 's': pagesize = strtoul(optarg, NULL, 0);	break;
+		case 'n': appsize = strtoul(optarg, NULL, 0);	break;
+		default:  usage(argv[0]);
+		}
+	}
+	if ((optind != argc - 1) || (pagesize & (pagesize - 1)) || (appsize && pagesize && (appsize % pagesize)) ||
+	    ((flags & DELTA_LZ) && ((lzBits < LZSS_MINBITS) || (lzBits > LZSS_MAXBITS))))
+		usage(argv[0]);
+
+	if (libusb_init(NULL) < 0)
+		return 1;
+	if (!(handle = libusb_open_device_with_vid_pid(NULL, USBASP_VID, USBASP_PID))) {
+		fprintf(stderr, "%s: no USBasp found\n", argv[0]);
+		libusb_exit(NULL);
+		return 1;
+	}
+
+	/* options given win over what the boot loader tells */
+	rc = controlIn(handle, USBASP_FUNC_GETCAPABILITIES, 0, 0, capsBuf, sizeof(capsBuf));
+	if (caps_parse(capsBuf, rc, &caps) == 0) {
+		if (!pagesize)
+			pagesize = caps.page_size;
+		if (!appsize)
+			appsize = caps.app_size;
+		if (caps.features & CAPS_LONG_TRANSFERS)
+			longTransfers = 1;
+		if (!(caps.features & CAPS_PAGE_DIGESTS))
+			flags |= DELTA_FULL;
+		if ((caps.features & CAPS_LZ_WRITE) && !(flags & DELTA_LZ)) {
+			flags |= DELTA_LZ;
+			lzBits = caps.lz_window_bits;
+		}
+	}
+	if (!pagesize || !appsize || (appsize % pagesize)) {
+		libusb_close(handle);
+		libusb_exit(NULL);
+		usage(argv[0]);
+	}
+
+	image	= malloc(appsize);
+	used	= calloc(appsize, 1);
+	if (!image || !used)
+		return 1;
+	memset(image, 0xff, appsize);
+	if ((end = ihex_read(argv[optind], image, used, appsize)) < 0)
+		return 1;
+	end = ((end + pagesize - 1) / pagesize) * pagesize;
+
+	t.control_in	= controlIn;
+	t.control_out	= controlOut;
+	t.ctx		= handle;
+	t.max_transfer	= longTransfers ? 4096 : USBASP_MAXTRANSFER;
+	t.lz_window_bits = lzBits;
+
+	controlIn(handle, USBASP_FUNC_CONNECT, 0, 0, dummy, sizeof(dummy));
+	rc = delta_upload(&t, image, used, end, pagesize, flags, &stats);
+	controlIn(handle, USBASP_FUNC_DISCONNECT, 0, 0, dummy, sizeof(dummy));
+
+	libusb_close(handle);
+	libusb_exit(NULL);
+	if (rc < 0) {
+		fprintf(stderr, "%s: transfer error\n", argv[0]);
+		return 1;
+	}
+	printf("%lu pages in image, %lu sent (%lu bytes), %lu failed to verify\n", (unsigned long)stats.pages,
+		(unsigned long)stats.written, (unsigned long)stats.bytes, (unsigned long)stats.failed);
+	return stats.failed ? 1 : 0;
+}
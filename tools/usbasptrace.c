@@ -0,0 +1,71 @@
+/* Name: usbasptrace.c
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-18
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Reads and prints the event trace of a USBaspLoader built with
+ * CONFIG_USE__TRACE (see trace.h). The boot loader must still be active,
+ * so read it before the programmer disconnects or build the boot loader
+ * with CONFIG_NO__EXIT_AFTER_UPLOAD. Needs libusb-1.0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <getopt.h>
+#include <libusb.h>
+
+#include "trace.h"
+
+#define USBASP_VID	0x16c0
+#define USBASP_PID	0x05dc
+#define TIMEOUT_MS	5000
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s -k khz\n"
+		"  -k khz  clock of the boot loader (F_CPU / 1000)\n",
+		prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	libusb_device_handle	*handle;
+	uint8_t			buf[2 + 4 * 255];
+	unsigned long		khz = 0;
+	int			opt, len;
+
+	while ((opt = getopt(argc, argv, "k:")) != -1) {
+		switch (opt) {
+		case 'k': khz = strtoul(optarg, NULL, 0);	break;
+		default:  usage(argv[0]);
+		}
+	}
+	if ((optind != argc) || !khz)
+		usage(argv[0]);
+
+	if (libusb_init(NULL) < 0)
+		return 1;
+	if (!(handle = libusb_open_device_with_vid_pid(NULL, USBASP_VID, USBASP_PID))) {
+		fprintf(stderr, "%s: no USBasp found\n", argv[0]);
+		libusb_exit(NULL);
+		return 1;
+	}
+	len = libusb_control_transfer(handle, LIBUSB_REQUEST_TYPE_VENDOR | LIBUSB_RECIPIENT_DEVICE | LIBUSB_ENDPOINT_IN,
+				      USBASP_FUNC_GETTRACE, 0, 0, buf, sizeof(buf), TIMEOUT_MS);
+	libusb_close(handle);
+	libusb_exit(NULL);
+	if (len < 0) {
+		fprintf(stderr, "%s: transfer error\n", argv[0]);
+		return 1;
+	}
+	if (trace_print(stdout, buf, len, khz) < 0) {
+		fprintf(stderr, "%s: no trace, boot loader built without CONFIG_USE__TRACE?\n", argv[0]);
+		return 1;
+	}
+	return 0;
+}
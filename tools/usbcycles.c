@@ -0,0 +1,1321 @@
+/* Name: usbcycles.c
+ * Project: USBaspLoader (tools)
+ * Creation Date: 2026-10-18
+ * Tabsize: 4
+ * License: GNU GPL v2 (see License.txt)
+ */
+
+/*
+ * Static cycle check of the V-USB interrupt handler (usbdrvasm*.inc).
+ *
+ * Reads the output of "avr-objdump -d usbdrv/usbdrvasm.o" and follows
+ * every path through the interrupt handler, counting the cycles between
+ * sync points: "in" from USBIN samples a received bit, "out" to USBOUT
+ * drives a transmitted bit. The known bits of the registers are tracked
+ * (loop counters, leap cycles, the bit stuffing history) as far as they
+ * decide a branch later; data read from the port or from memory is
+ * unknown and both ways of every branch depending on it are followed.
+ *
+ * The bus is assumed to run at exactly USB_CFG_CLOCK_KHZ / 1500 cycles
+ * per bit. Each received packet sets its own bit grid with its first
+ * sample, all samples of the packet which are used must stay within -w
+ * cycles around that grid. The host resynchronizes on what we send, so
+ * there the deviation may drift by the rate tolerance of 1.5% and must
+ * stay within half of -w, up to the length of the longest low speed
+ * packet. A gap of more than four bit times ends a packet, so does
+ * writing USBDDR when sending. The 12.8 and 16.5 MHz modules
+ * resynchronize on edges while receiving, only their transmitter is
+ * checked. Cycle counts are those of the classic AVR core.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <ctype.h>
+#include <getopt.h>
+
+#define MAXINSN		8192
+#define MAXSTATES	(1L << 22)
+#define MAXEDGES	1024
+#define MAXPATH		256
+#define MAXRATE		0.015		/* low speed: 1.5 Mbit/s +- 1.5% */
+#define MAXBITS		(12 * 8 * 7 / 6)	/* sync, PID, 8 bytes of data and CRC, stuffed */
+
+#define LIVE_REG(r)	(((r) >= 0) ? 1ULL << (r) : 0)
+#define LIVE_PAIR(r)	(((r) >= 0) ? 3ULL << (r) : 0)
+#define LIVE_FLAGS(f)	((uint64_t)(f) << 32)
+
+/* status register bits */
+#define SR_C	0x01
+#define SR_Z	0x02
+#define SR_N	0x04
+#define SR_V	0x08
+#define SR_S	0x10
+#define SR_H	0x20
+#define SR_T	0x40
+#define SR_I	0x80
+#define FLAG_NAMES	"cznvsht"	/* sec, clc, sez, ... in bit order */
+
+enum { FLOW_NEXT, FLOW_JUMP, FLOW_BRANCH, FLOW_SKIP, FLOW_END };
+enum { SYNC_RX, SYNC_TX };
+
+/* bits of the registers and flags (SR_*) */
+typedef struct live {
+	uint8_t		reg[32];
+	uint8_t		flags;
+} live_t;
+
+typedef struct insn {
+	unsigned long	addr;
+	unsigned	size;
+	char		mnem[8];
+	int		nops;
+	char		op[3][16];
+	unsigned	cycles;		/* not taken / no skip */
+	int		flow;
+	long		target;		/* index of the branch target, -1 if outside */
+	int		unknown;	/* line of data or an unsupported instruction */
+	live_t		live;		/* what decides a branch later */
+	const char	*sym;		/* preceding symbol */
+	unsigned long	symaddr;
+} insn_t;
+
+/* one direction: time since the last sync point and deviation from the bit grid (1/1500 cycles) */
+typedef struct timing {
+	int32_t		last;		/* instruction of the last sync point, -1 between packets */
+	int32_t		cycles;
+	int32_t		dev, min, max;
+	int32_t		pending;	/* cycles of the last interval when sending, or until the
+					   sample not used yet when receiving; -1 if none */
+	int32_t		sample, sampleReg;	/* instruction and register of that sample */
+	int32_t		bits;		/* sent so far */
+} timing_t;
+
+/* everything up to parent is compared to find states seen before, keep it free of padding */
+typedef struct state {
+	int32_t		pc;
+	uint8_t		reg[32];
+	uint8_t		kmask[32];	/* known bits of reg[], unknown ones are 0 in reg[] */
+	uint8_t		sreg, sknown;
+	int8_t		zreg;		/* if Z is unknown: register which equals zval if Z is set */
+	uint8_t		zval;
+	timing_t	t[2];
+	long		parent;		/* index into states[], -1 for the entry */
+} state_t;
+
+typedef struct edge {
+	int		from, to;	/* instruction indices */
+	unsigned	cycles;
+} edge_t;
+
+static insn_t		insn[MAXINSN];
+static int		ninsn;
+static state_t		*states;
+static long		nstates;
+static long		*hashTable;
+static long		hashSize = 2 * MAXSTATES;
+static long		*stack;
+static long		nstack;
+static edge_t		edges[MAXEDGES];
+static int		nedges;
+
+static long		khz;		/* USB_CFG_CLOCK_KHZ */
+static int		usbin = -1;	/* I/O address of PINx, DDRx and PORTx follow */
+static long		window;		/* 1/1500 cycles */
+static int		checkRx = 1;	/* off for the modules which resynchronize on edges */
+static long		worstSpread[2];
+static long		worstState[2] = { -1, -1 };
+static unsigned long	syncCount[2];
+static unsigned		eopMin = ~0U, eopMax;
+
+/* ------------------------------------------------------------------------- */
+
+static const char	*one[] = {
+	"add", "adc", "sub", "subi", "sbc", "sbci", "and", "andi", "or", "ori", "eor", "com", "neg",
+	"sbr", "cbr", "inc", "dec", "tst", "clr", "ser", "cp", "cpc", "cpi", "mov", "movw", "ldi",
+	"in", "out", "lsl", "lsr", "rol", "ror", "asr", "swap", "bst", "bld", "sec", "clc", "sen",
+	"cln", "sez", "clz", "sei", "cli", "ses", "cls", "sev", "clv", "set", "clt", "seh", "clh",
+	"nop", "wdr", NULL
+};
+static const char	*two[] = {
+	"adiw", "sbiw", "mul", "ld", "ldd", "st", "std", "lds", "sts", "push", "pop", "sbi", "cbi", NULL
+};
+static const char	*skips[] = { "cpse", "sbrc", "sbrs", "sbic", "sbis", NULL };
+static const char	*ends[] = { "ret", "reti", "ijmp", "eijmp", "icall", "eicall", "rcall", "call", NULL };
+
+static int inList(const char *s, const char **list)
+{
+	for (; *list; list++)
+		if (!strcmp(s, *list))
+			return 1;
+	return 0;
+}
+
+/* register operand, X, Y and Z give the low register of the pair */
+static int reg(const insn_t *p, int n)
+{
+	const char	*s = p->op[n];
+
+	if (s[0] == '-')
+		s++;
+	if (s[0] == 'r')
+		return atoi(s + 1);
+	if (s[0] >= 'X' && s[0] <= 'Z')
+		return 26 + 2 * (s[0] - 'X');
+	return -1;
+}
+
+static long num(const insn_t *p, int n)
+{
+	return strtol(p->op[n], NULL, 0);
+}
+
+static int isSync(const insn_t *p, int d)
+{
+	if (d == SYNC_RX)
+		return checkRx && !strcmp(p->mnem, "in") && (num(p, 1) == usbin);
+	return !strcmp(p->mnem, "out") && (num(p, 0) == usbin + 2);
+}
+
+static long findInsn(unsigned long addr)
+{
+	long	lo = 0, hi = ninsn - 1, mid;
+
+	while (lo <= hi) {
+		mid = (lo + hi) / 2;
+		if (insn[mid].addr == addr)
+			return mid;
+		if (insn[mid].addr < addr)
+			lo = mid + 1;
+		else
+			hi = mid - 1;
+	}
+	return -1;
+}
+
+/* instruction following i in memory, -1 if there is a gap */
+static int follows(int i)
+{
+	return ((i >= 0) && (i + 1 < ninsn) && (insn[i + 1].addr == insn[i].addr + insn[i].size)) ? i + 1 : -1;
+}
+
+static int classify(insn_t *p)
+{
+	const char	*m = p->mnem, *s;
+
+	if (inList(m, one)) {
+		p->cycles = 1;
+		p->flow = FLOW_NEXT;
+	} else if (inList(m, two)) {
+		p->cycles = 2;
+		p->flow = FLOW_NEXT;
+	} else if (!strcmp(m, "lpm") || !strcmp(m, "elpm")) {
+		p->cycles = 3;
+		p->flow = FLOW_NEXT;
+	} else if (!strcmp(m, "rjmp") || !strcmp(m, "jmp") || (m[0] == 'b' && m[1] == 'r')) {
+		p->cycles = (m[0] == 'j') ? 3 : (m[0] == 'r') ? 2 : 1;
+		p->flow = (m[0] == 'b') ? FLOW_BRANCH : FLOW_JUMP;
+		/* ".+N" relative to the next instruction or an absolute address */
+		s = p->op[p->nops - 1];
+		p->target = (s[0] == '.') ? (long)p->addr + 2 + strtol(s + 1, NULL, 0) : (long)strtoul(s, NULL, 0);
+	} else if (inList(m, skips)) {
+		p->cycles = 1;
+		p->flow = FLOW_SKIP;
+	} else if (inList(m, ends)) {
+		p->cycles = 4;
+		p->flow = FLOW_END;
+	} else {
+		p->flow = FLOW_END;
+		return -1;
+	}
+	return 0;
+}
+
+/* lines of avr-objdump -d: "00000010 <label>:" and "  1e:\t0f 9b       \tsbis\t0x09, 4\t; 9" */
+static int readDisassembly(FILE *f)
+{
+	static char	symbols[MAXINSN][48];
+	char		line[256], *s, *t;
+	int		nsym = 0, text = 0, lineno = 0, n, i;
+	const char	*sym = "?";
+	unsigned long	symaddr = 0, addr;
+	insn_t		*p;
+
+	while (fgets(line, sizeof(line), f)) {
+		lineno++;
+		if (!strncmp(line, "Disassembly of section ", 23)) {
+			text = !strncmp(line + 23, ".text", 5);
+			continue;
+		}
+		if (!text)
+			continue;
+		if (isxdigit((unsigned char)line[0]) && (s = strchr(line, '<')) && (t = strstr(s, ">:"))) {
+			if (nsym == MAXINSN)
+				continue;
+			*t = 0;
+			snprintf(symbols[nsym], sizeof(symbols[nsym]), "%s", s + 1);
+			sym = symbols[nsym++];
+			symaddr = strtoul(line, NULL, 16);
+			continue;
+		}
+		addr = strtoul(line, &s, 16);
+		if ((s == line) || (*s != ':') || !strchr(s, '\t'))
+			continue;
+		/* raw bytes, then mnemonic and operands, then an optional comment */
+		s = strchr(s, '\t') + 1;
+		for (n = 0; isxdigit((unsigned char)s[0]) && isxdigit((unsigned char)s[1]) && (s[2] == ' '); s += 3)
+			n++;
+		s += strspn(s, " \t");
+		if ((n < 2) || !*s || (*s == '.') || (*s == '\n'))
+			continue;			/* data (.word) or a continuation line */
+		if (ninsn == MAXINSN) {
+			fprintf(stderr, "usbcycles: too many instructions\n");
+			return -1;
+		}
+		p = &insn[ninsn];
+		memset(p, 0, sizeof(*p));
+		p->addr = addr;
+		p->size = n;
+		p->sym = sym;
+		p->symaddr = symaddr;
+		if ((t = strchr(s, ';')))
+			*t = 0;
+		n = strcspn(s, " \t\n");
+		snprintf(p->mnem, sizeof(p->mnem), "%.*s", n, s);
+		for (s += n, i = 0; i < 3; i++) {
+			s += strspn(s, " \t,\n");
+			if (!(n = strcspn(s, ", \t\n")))
+				break;
+			snprintf(p->op[i], sizeof(p->op[i]), "%.*s", n, s);
+			s += n;
+		}
+		p->nops = i;
+		/* avr-objdump shows lsl and rol as add and adc of a register with itself */
+		if ((!strcmp(p->mnem, "add") || !strcmp(p->mnem, "adc")) && (i == 2) && !strcmp(p->op[0], p->op[1])) {
+			strcpy(p->mnem, (p->mnem[2] == 'd') ? "lsl" : "rol");
+			p->nops = 1;
+		}
+		p->unknown = (classify(p) < 0) ? lineno : 0;
+		ninsn++;
+	}
+	for (i = 0; i < ninsn; i++)
+		if ((insn[i].flow == FLOW_JUMP) || (insn[i].flow == FLOW_BRANCH))
+			insn[i].target = findInsn(insn[i].target);
+	return ninsn ? 0 : -1;
+}
+
+/* ------------------------------------------------------------------------- */
+
+#define KNOWN(s, r)	(((r) >= 0) && ((s)->kmask[r] == 0xff))
+#define SETREG(s, r, v)	((s)->reg[r] = (v), (s)->kmask[r] = 0xff)
+
+/* sets the bits of r given in mask, the others become unknown */
+static void setBits(state_t *s, int r, unsigned value, unsigned mask)
+{
+	if (r >= 0) {
+		s->kmask[r] = mask & 0xff;
+		s->reg[r] = value & mask & 0xff;
+	}
+}
+
+static void forget(state_t *s, int r)
+{
+	setBits(s, r, 0, 0);
+}
+
+static void setFlags(state_t *s, unsigned mask, unsigned value)
+{
+	s->sreg = (s->sreg & ~mask) | (value & mask);
+	s->sknown |= mask;
+}
+
+static void forgetFlags(state_t *s, unsigned mask)
+{
+	s->sreg &= ~mask;
+	s->sknown &= ~mask;
+}
+
+/* Z, N and S of an 8 bit result, with V as given */
+static unsigned flagsOf(unsigned res, int v)
+{
+	unsigned	f = v ? SR_V : 0;
+
+	if (!(res & 0xff))
+		f |= SR_Z;
+	if (res & 0x80)
+		f |= SR_N;
+	if (!(f & SR_N) != !(f & SR_V))
+		f |= SR_S;
+	return f;
+}
+
+/*
+ * Z and N of a result of which only the bits in mask are known. If Z is
+ * unknown, a later branch on it tells whether register d is zero.
+ */
+static void partialFlags(state_t *s, int d, unsigned res, unsigned mask)
+{
+	forgetFlags(s, SR_Z | SR_N | SR_S);
+	if (res & mask)
+		setFlags(s, SR_Z, 0);
+	else
+		s->zreg = d, s->zval = 0;
+	if (mask & 0x80)
+		setFlags(s, SR_N, (res & 0x80) ? SR_N : 0);
+}
+
+static void logic(state_t *s, const insn_t *p, int d, int r, unsigned b)
+{
+	const char	*m = p->mnem;
+	unsigned	a = s->reg[d], ka = s->kmask[d], kb = 0xff, res, k;
+	int		write = strcmp(m, "tst");
+
+	if (r >= 0)
+		b = s->reg[r], kb = s->kmask[r];
+	if (!strcmp(m, "and") || !strcmp(m, "andi") || !strcmp(m, "cbr") || !strcmp(m, "tst")) {
+		if (!strcmp(m, "cbr"))
+			b = ~b & 0xff;
+		if (!strcmp(m, "tst"))
+			b = a, kb = ka;
+		res = a & b;
+		k = (ka & kb) | (ka & ~a) | (kb & ~b);		/* known zeros decide */
+	} else if (!strcmp(m, "eor")) {
+		res = a ^ b;
+		k = (r == d) ? 0xff : (ka & kb);
+	} else if (!strcmp(m, "com")) {
+		res = ~a;
+		k = ka;
+	} else {
+		res = a | b;
+		k = (ka & kb) | (ka & a) | (kb & b);		/* known ones decide */
+	}
+	k &= 0xff;
+	res &= k;
+	if (!strcmp(m, "com"))
+		setFlags(s, SR_C, SR_C);
+	setFlags(s, SR_V, 0);
+	if (write)
+		setBits(s, d, res, k);
+	if (k == 0xff)
+		setFlags(s, SR_Z | SR_N | SR_S, flagsOf(res, 0));
+	else
+		partialFlags(s, d, res, k);
+	/* V is clear, so S equals N */
+	if (s->sknown & SR_N)
+		setFlags(s, SR_S, (s->sreg & SR_N) ? SR_S : 0);
+}
+
+static void arith(state_t *s, const insn_t *p, int d, int r, unsigned b)
+{
+	const char	*m = p->mnem;
+	unsigned	a = s->reg[d], c = s->sreg & SR_C, res, f, lo, hi;
+	int		sub = (m[0] == 's' || m[0] == 'c' || m[0] == 'n');
+	int		carry = !strcmp(m, "adc") || !strcmp(m, "sbc") || !strcmp(m, "sbci") || !strcmp(m, "cpc");
+	int		write = (m[0] != 'c'), known;
+
+	if (r >= 0)
+		b = s->reg[r];
+	if (!strcmp(m, "neg"))
+		b = a, a = 0;
+	known = KNOWN(s, d) && ((r < 0) || KNOWN(s, r)) && (!carry || ((s->sknown & (SR_C | SR_Z)) == (SR_C | SR_Z)));
+	if (!strcmp(m, "sub") && (r == d))
+		known = 1, a = b = 0;
+	if (!known) {
+		forgetFlags(s, SR_C | SR_Z | SR_N | SR_V | SR_S | SR_H);
+		/* a compare with a constant is often decided by the known bits alone */
+		if (sub && !carry && strcmp(m, "neg") && ((r < 0) || KNOWN(s, r))) {
+			lo = a & s->kmask[d];
+			hi = a | (~s->kmask[d] & 0xff);
+			if ((hi < b) || (lo >= b))
+				setFlags(s, SR_C, (hi < b) ? SR_C : 0);
+			if ((b & s->kmask[d]) != lo)
+				setFlags(s, SR_Z, 0);
+			else if (write)
+				s->zreg = d, s->zval = 0;
+			else
+				s->zreg = d, s->zval = b;
+		}
+		if (write)
+			forget(s, d);
+		return;
+	}
+	if (!carry)
+		c = 0;
+	if (sub) {
+		res = (a - b - c) & 0x1ff;
+		f = flagsOf(res, ((a ^ b) & (a ^ res) & 0x80) != 0);
+		if (b + c > a)
+			f |= SR_C;
+		if ((b & 0xf) + c > (a & 0xf))
+			f |= SR_H;
+		if (!strcmp(m, "neg"))
+			f = (f & ~SR_C) | ((res & 0xff) ? SR_C : 0);
+	} else {
+		res = a + b + c;
+		f = flagsOf(res, ((a ^ res) & (b ^ res) & 0x80) != 0);
+		if (res & 0x100)
+			f |= SR_C;
+		if (((a & 0xf) + (b & 0xf) + c) & 0x10)
+			f |= SR_H;
+	}
+	/* sbc, sbci and cpc only clear Z */
+	if (carry && sub && !(s->sreg & SR_Z))
+		f &= ~SR_Z;
+	if (write)
+		SETREG(s, d, res & 0xff);
+	setFlags(s, SR_C | SR_Z | SR_N | SR_V | SR_S | SR_H, f);
+}
+
+/* lsl, rol, lsr, ror and asr; the bits shifted in may be known when the register is not */
+static void shift(state_t *s, const insn_t *p, int d)
+{
+	const char	*m = p->mnem;
+	unsigned	a = s->reg[d], ka = s->kmask[d], cin = (s->sreg & SR_C) ? 1 : 0;
+	unsigned	ckn = (s->sknown & SR_C) ? 1 : 0, res, k, cout;
+	int		left = (m[0] == 'l' && m[2] == 'l') || !strcmp(m, "rol");
+
+	if (left) {
+		res = (a << 1) | ((m[0] == 'r') ? cin : 0);
+		k = (ka << 1) | ((m[0] == 'r') ? ckn : 1);
+		cout = a >> 7;
+		ckn = ka >> 7;
+	} else {
+		res = a >> 1;
+		k = ka >> 1;
+		if (!strcmp(m, "ror"))
+			res |= cin << 7, k |= ckn << 7;
+		else if (!strcmp(m, "asr"))
+			res |= a & 0x80, k |= ka & 0x80;
+		else
+			k |= 0x80;
+		cout = a & 1;
+		ckn = ka & 1;
+	}
+	k &= 0xff;
+	res &= k;
+	setBits(s, d, res, k);
+	forgetFlags(s, SR_C | SR_Z | SR_N | SR_V | SR_S | SR_H);
+	if (k == 0xff)
+		setFlags(s, SR_Z | SR_N, flagsOf(res, 0));
+	else
+		partialFlags(s, d, res, k);
+	if (ckn) {
+		/* V = N ^ C and S = N ^ V = C */
+		setFlags(s, SR_C | SR_S, cout ? (SR_C | SR_S) : 0);
+		if (s->sknown & SR_N)
+			setFlags(s, SR_V, (!(s->sreg & SR_N) != !cout) ? SR_V : 0);
+	}
+}
+
+/* the effect of p on the registers and flags in s */
+static void execute(state_t *s, const insn_t *p)
+{
+	const char	*m = p->mnem;
+	int		d = (p->nops > 0) ? reg(p, 0) : -1, r = (p->nops > 1) ? reg(p, 1) : -1, i;
+	unsigned	b = ((p->nops > 1) && (r < 0)) ? (unsigned)num(p, 1) & 0xff : 0, bit;
+	const char	*ptr;
+
+	if (!strcmp(m, "ldi") || !strcmp(m, "ser")) {
+		SETREG(s, d, (m[0] == 's') ? 0xff : b);
+	} else if (!strcmp(m, "mov") || !strcmp(m, "movw")) {
+		for (i = 0; i < ((m[3] == 'w') ? 2 : 1); i++)
+			setBits(s, d + i, s->reg[r + i], s->kmask[r + i]);
+	} else if (!strcmp(m, "clr")) {
+		SETREG(s, d, 0);
+		setFlags(s, SR_Z | SR_N | SR_V | SR_S, SR_Z);
+	} else if (!strcmp(m, "and") || !strcmp(m, "andi") || !strcmp(m, "cbr") || !strcmp(m, "or") ||
+		   !strcmp(m, "ori") || !strcmp(m, "sbr") || !strcmp(m, "eor") || !strcmp(m, "tst") ||
+		   !strcmp(m, "com")) {
+		logic(s, p, d, r, b);
+	} else if (!strcmp(m, "add") || !strcmp(m, "adc") || !strcmp(m, "sub") || !strcmp(m, "subi") ||
+		   !strcmp(m, "sbc") || !strcmp(m, "sbci") || !strcmp(m, "cp") || !strcmp(m, "cpc") ||
+		   !strcmp(m, "cpi") || !strcmp(m, "neg")) {
+		arith(s, p, d, r, b);
+	} else if (!strcmp(m, "inc") || !strcmp(m, "dec")) {
+		if (KNOWN(s, d)) {
+			b = (s->reg[d] + ((m[0] == 'i') ? 1 : 0xff)) & 0xff;
+			SETREG(s, d, b);
+			setFlags(s, SR_Z | SR_N | SR_V | SR_S, flagsOf(b, b == ((m[0] == 'i') ? 0x80 : 0x7f)));
+		} else {
+			forget(s, d);
+			forgetFlags(s, SR_Z | SR_N | SR_V | SR_S);
+			s->zreg = d, s->zval = 0;
+		}
+	} else if (!strcmp(m, "lsl") || !strcmp(m, "rol") || !strcmp(m, "lsr") || !strcmp(m, "ror") ||
+		   !strcmp(m, "asr")) {
+		shift(s, p, d);
+	} else if (!strcmp(m, "swap")) {
+		setBits(s, d, (s->reg[d] << 4) | (s->reg[d] >> 4), (s->kmask[d] << 4) | (s->kmask[d] >> 4));
+	} else if (!strcmp(m, "bst")) {
+		bit = 1 << num(p, 1);
+		if (s->kmask[d] & bit)	setFlags(s, SR_T, (s->reg[d] & bit) ? SR_T : 0);
+		else			forgetFlags(s, SR_T);
+	} else if (!strcmp(m, "bld")) {
+		bit = 1 << num(p, 1);
+		setBits(s, d, (s->reg[d] & ~bit) | ((s->sreg & SR_T) ? bit : 0),
+			(s->kmask[d] & ~bit) | ((s->sknown & SR_T) ? bit : 0));
+	} else if (!strcmp(m, "adiw") || !strcmp(m, "sbiw") || !strcmp(m, "mul")) {
+		forget(s, (m[0] == 'm') ? 0 : d);
+		forget(s, (m[0] == 'm') ? 1 : d + 1);
+		forgetFlags(s, SR_C | SR_Z | SR_N | SR_V | SR_S);
+	} else if ((strlen(m) == 3) && (!strncmp(m, "se", 2) || !strncmp(m, "cl", 2)) && strchr(FLAG_NAMES, m[2])) {
+		/* sec, clc, set, clt, ... */
+		setFlags(s, 1 << (strchr(FLAG_NAMES, m[2]) - FLAG_NAMES), (m[0] == 's') ? 0xff : 0);
+	} else if (!strcmp(m, "in") || !strcmp(m, "pop") || !strcmp(m, "lds") || !strcmp(m, "ld") ||
+		   !strcmp(m, "ldd") || !strcmp(m, "lpm") || !strcmp(m, "elpm")) {
+		/* data from the ports, the stack and memory is unknown */
+		forget(s, (p->nops == 0) ? 0 : d);
+		ptr = (p->nops > 1) ? p->op[p->nops - 1] : "";
+		if (m[0] != 'i' && m[0] != 'p' && (ptr[0] == '-' || (*ptr && ptr[strlen(ptr) - 1] == '+'))) {
+			forget(s, reg(p, p->nops - 1));
+			forget(s, reg(p, p->nops - 1) + 1);
+		}
+	} else if (!strcmp(m, "st")) {
+		ptr = p->op[0];
+		if (ptr[0] == '-' || ptr[strlen(ptr) - 1] == '+') {
+			forget(s, d);
+			forget(s, d + 1);
+		}
+	} else if (!strcmp(m, "out") && (num(p, 0) == 0x3f)) {
+		forgetFlags(s, 0xff);
+	}
+	/* push, sts, std, sbi, cbi, nop, ... leave registers and flags alone */
+}
+
+/* the flag a conditional branch tests, set tells whether it branches if the flag is set */
+static unsigned branchFlag(const insn_t *p, int *set)
+{
+	static const struct { const char *name; unsigned flag; int set; } br[] = {
+		{ "brcs", SR_C, 1 }, { "brlo", SR_C, 1 }, { "brcc", SR_C, 0 }, { "brsh", SR_C, 0 },
+		{ "breq", SR_Z, 1 }, { "brne", SR_Z, 0 }, { "brmi", SR_N, 1 }, { "brpl", SR_N, 0 },
+		{ "brvs", SR_V, 1 }, { "brvc", SR_V, 0 }, { "brlt", SR_S, 1 }, { "brge", SR_S, 0 },
+		{ "brhs", SR_H, 1 }, { "brhc", SR_H, 0 }, { "brts", SR_T, 1 }, { "brtc", SR_T, 0 },
+		{ "brie", SR_I, 1 }, { "brid", SR_I, 0 }, { NULL, 0, 0 }
+	};
+	int	i;
+
+	if (!strcmp(p->mnem, "brbs") || !strcmp(p->mnem, "brbc")) {
+		*set = (p->mnem[3] == 's');
+		return 1 << num(p, 0);
+	}
+	for (i = 0; br[i].name; i++) {
+		if (!strcmp(p->mnem, br[i].name)) {
+			*set = br[i].set;
+			return br[i].flag;
+		}
+	}
+	return 0;
+}
+
+/* outcome of a branch or skip condition: 1, 0 or -1 if unknown */
+static int condition(const state_t *s, const insn_t *p)
+{
+	const char	*m = p->mnem;
+	int		set, d = reg(p, 0), r = reg(p, 1);
+	unsigned	flag = branchFlag(p, &set), bit;
+
+	if (flag)
+		return (s->sknown & flag) ? (((s->sreg & flag) != 0) == set) : -1;
+	if (!strcmp(m, "sbrc") || !strcmp(m, "sbrs")) {
+		bit = 1 << num(p, 1);
+		return (s->kmask[d] & bit) ? (((s->reg[d] & bit) != 0) == (m[3] == 's')) : -1;
+	}
+	if (!strcmp(m, "cpse"))
+		return (KNOWN(s, d) && KNOWN(s, r)) ? (s->reg[d] == s->reg[r]) : -1;
+	return -1;			/* sbis, sbic: port input */
+}
+
+/* what an undecided branch or skip of p tells about the path with the given outcome */
+static void refine(state_t *s, const insn_t *p, int outcome)
+{
+	const char	*m = p->mnem;
+	int		set, d = reg(p, 0), z = s->zreg;
+	unsigned	flag = branchFlag(p, &set), bit, unknown;
+
+	if (!strcmp(m, "sbrc") || !strcmp(m, "sbrs")) {
+		bit = 1 << num(p, 1);
+		setBits(s, d, (outcome == (m[3] == 's')) ? (s->reg[d] | bit) : s->reg[d], s->kmask[d] | bit);
+		return;
+	}
+	if (!flag)
+		return;
+	setFlags(s, flag, (outcome == set) ? flag : 0);
+	if ((flag != SR_Z) || (z < 0))
+		return;
+	/* register zreg equals zval if Z is set, else it differs in a bit not known yet */
+	unknown = ~s->kmask[z] & 0xff;
+	if (s->sreg & SR_Z)
+		SETREG(s, z, s->zval);
+	else if (unknown && !(unknown & (unknown - 1)) && ((s->zval & s->kmask[z]) == s->reg[z]))
+		setBits(s, z, s->reg[z] | (~s->zval & unknown), 0xff);
+	s->zreg = -1;
+}
+
+/* registers and flags written and read by p (LIVE_*), returns 1 if p decides the control flow */
+static int defUse(const insn_t *p, uint64_t *def, uint64_t *use)
+{
+	const char	*m = p->mnem, *ptr = (p->nops > 0) ? p->op[p->nops - 1] : "";
+	int		d = (p->nops > 0) ? reg(p, 0) : -1, r = (p->nops > 1) ? reg(p, 1) : -1, set;
+	const uint64_t	arith = LIVE_FLAGS(SR_C | SR_Z | SR_N | SR_V | SR_S | SR_H);
+	const uint64_t	logic = LIVE_FLAGS(SR_Z | SR_N | SR_V | SR_S);
+
+	*def = *use = 0;
+	if ((p->flow == FLOW_BRANCH) || (p->flow == FLOW_SKIP)) {
+		if (!strcmp(m, "sbrc") || !strcmp(m, "sbrs"))
+			*use = LIVE_REG(d);
+		else if (!strcmp(m, "cpse"))
+			*use = LIVE_REG(d) | LIVE_REG(r);
+		else if (m[0] == 'b')
+			*use = LIVE_FLAGS(branchFlag(p, &set));
+		return 1;
+	}
+	if (!strcmp(m, "ldi") || !strcmp(m, "ser")) {
+		*def = LIVE_REG(d);
+	} else if (!strcmp(m, "mov")) {
+		*def = LIVE_REG(d);
+		*use = LIVE_REG(r);
+	} else if (!strcmp(m, "movw")) {
+		*def = LIVE_PAIR(d);
+		*use = LIVE_PAIR(r);
+	} else if (!strcmp(m, "clr") || (!strcmp(m, "eor") && (d == r))) {
+		*def = LIVE_REG(d) | logic;
+	} else if (!strcmp(m, "and") || !strcmp(m, "andi") || !strcmp(m, "cbr") || !strcmp(m, "or") ||
+		   !strcmp(m, "ori") || !strcmp(m, "sbr") || !strcmp(m, "eor") || !strcmp(m, "com") ||
+		   !strcmp(m, "inc") || !strcmp(m, "dec")) {
+		*def = LIVE_REG(d) | logic | (!strcmp(m, "com") ? LIVE_FLAGS(SR_C) : 0);
+		*use = LIVE_REG(d) | LIVE_REG(r);
+	} else if (!strcmp(m, "tst")) {
+		*def = logic;
+		*use = LIVE_REG(d);
+	} else if (!strcmp(m, "add") || !strcmp(m, "adc") || !strcmp(m, "lsl") || !strcmp(m, "rol") ||
+		   !strcmp(m, "sub") || !strcmp(m, "subi") || !strcmp(m, "sbc") || !strcmp(m, "sbci") ||
+		   !strcmp(m, "cp") || !strcmp(m, "cpc") || !strcmp(m, "cpi") || !strcmp(m, "neg")) {
+		*def = arith | ((m[0] != 'c') ? LIVE_REG(d) : 0);
+		*use = LIVE_REG(d) | LIVE_REG(r);
+		if (!strcmp(m, "adc") || !strcmp(m, "rol"))
+			*use |= LIVE_FLAGS(SR_C);
+		if (!strcmp(m, "sbc") || !strcmp(m, "sbci") || !strcmp(m, "cpc"))
+			*use |= LIVE_FLAGS(SR_C | SR_Z);
+	} else if (!strcmp(m, "lsr") || !strcmp(m, "ror") || !strcmp(m, "asr")) {
+		*def = LIVE_REG(d) | LIVE_FLAGS(SR_C | SR_Z | SR_N | SR_V | SR_S);
+		*use = LIVE_REG(d) | (!strcmp(m, "ror") ? LIVE_FLAGS(SR_C) : 0);
+	} else if (!strcmp(m, "swap")) {
+		*def = *use = LIVE_REG(d);
+	} else if (!strcmp(m, "bst")) {
+		*def = LIVE_FLAGS(SR_T);
+		*use = LIVE_REG(d);
+	} else if (!strcmp(m, "bld")) {
+		*def = LIVE_REG(d);
+		*use = LIVE_REG(d) | LIVE_FLAGS(SR_T);
+	} else if (!strcmp(m, "adiw") || !strcmp(m, "sbiw")) {
+		*def = LIVE_PAIR(d) | LIVE_FLAGS(SR_C | SR_Z | SR_N | SR_V | SR_S);
+		*use = LIVE_PAIR(d);
+	} else if (!strcmp(m, "mul")) {
+		*def = LIVE_PAIR(0) | LIVE_FLAGS(SR_C | SR_Z);
+		*use = LIVE_REG(d) | LIVE_REG(r);
+	} else if ((strlen(m) == 3) && (!strncmp(m, "se", 2) || !strncmp(m, "cl", 2)) && strchr(FLAG_NAMES, m[2])) {
+		*def = LIVE_FLAGS(1 << (strchr(FLAG_NAMES, m[2]) - FLAG_NAMES));
+	} else if (!strcmp(m, "in") || !strcmp(m, "pop") || !strcmp(m, "lds") || !strcmp(m, "ld") ||
+		   !strcmp(m, "ldd") || !strcmp(m, "lpm") || !strcmp(m, "elpm")) {
+		*def = LIVE_REG((p->nops == 0) ? 0 : d);
+		if ((m[0] == 'l') && (m[1] != 'd' || m[2] != 's') && ((ptr[0] == '-') || (*ptr && ptr[strlen(ptr) - 1] == '+'))) {
+			*def |= LIVE_PAIR(reg(p, p->nops - 1));
+			*use |= LIVE_PAIR(reg(p, p->nops - 1));
+		}
+	} else if (!strcmp(m, "st")) {
+		if ((p->op[0][0] == '-') || (p->op[0][strlen(p->op[0]) - 1] == '+'))
+			*def = *use = LIVE_PAIR(d);
+	} else if (!strcmp(m, "out") && (num(p, 0) == 0x3f)) {
+		*def = LIVE_FLAGS(0xff);
+		*use = LIVE_REG(r);
+	}
+	return 0;
+}
+
+/*
+ * The bits of registers and flags live before p, given those live after
+ * it. Shifts and logic work bit by bit, everything else needs all bits
+ * of its operands if any bit of the result is live.
+ */
+static void transfer(const insn_t *p, const live_t *out, live_t *in)
+{
+	const char	*m = p->mnem;
+	int		d = (p->nops > 0) ? reg(p, 0) : -1, r = (p->nops > 1) ? reg(p, 1) : -1, i, control;
+	unsigned	o = (d >= 0) ? out->reg[d] : 0, fl = out->flags, k = 0, bits, cin;
+	uint64_t	def, use;
+
+	*in = *out;
+	if (!strcmp(m, "sbrc") || !strcmp(m, "sbrs")) {
+		in->reg[d] |= 1 << num(p, 1);
+	} else if (!strcmp(m, "mov") || !strcmp(m, "movw")) {
+		for (i = 0; i < ((m[3] == 'w') ? 2 : 1); i++) {
+			o = out->reg[d + i];
+			in->reg[d + i] = 0;
+			in->reg[r + i] |= o;
+		}
+	} else if ((!strcmp(m, "and") || !strcmp(m, "andi") || !strcmp(m, "cbr") || !strcmp(m, "or") ||
+		    !strcmp(m, "ori") || !strcmp(m, "sbr") || !strcmp(m, "eor") || !strcmp(m, "com") ||
+		    !strcmp(m, "tst")) && !((m[0] == 'e') && (d == r))) {
+		/* V is cleared, N and S are bit 7, Z needs all bits */
+		bits = ((m[0] == 't') ? 0 : o) | ((fl & SR_Z) ? 0xff : 0) | ((fl & (SR_N | SR_S)) ? 0x80 : 0);
+		if (r < 0 && p->nops > 1) {
+			k = num(p, 1) & 0xff;
+			/* bits cleared or set by the constant do not depend on d */
+			bits &= (!strcmp(m, "andi")) ? k : ~k;
+		}
+		in->reg[d] = bits;
+		if (r >= 0)
+			in->reg[r] |= bits;
+		in->flags &= ~(SR_Z | SR_N | SR_V | SR_S | (!strcmp(m, "com") ? SR_C : 0));
+	} else if (!strcmp(m, "lsr") || !strcmp(m, "ror") || !strcmp(m, "asr")) {
+		/* C, V and S come from bit 0, N is bit 7 of the result, Z needs all */
+		bits = ((o & 0x7f) << 1) | ((fl & (SR_C | SR_V | SR_S)) ? 1 : 0) | ((fl & SR_Z) ? 0xff : 0);
+		cin = 0;
+		if ((o & 0x80) || (fl & (SR_N | SR_V))) {
+			if (m[0] == 'a')	bits |= 0x80;
+			else if (m[1] == 'o')	cin = SR_C;
+		}
+		in->reg[d] = bits & 0xff;
+		in->flags = (fl & ~(SR_C | SR_Z | SR_N | SR_V | SR_S)) | cin;
+	} else if (!strcmp(m, "lsl") || !strcmp(m, "rol")) {
+		bits = (o >> 1) | ((fl & SR_C) ? 0x80 : 0) | ((fl & (SR_Z | SR_N | SR_V | SR_S | SR_H)) ? 0xff : 0);
+		in->reg[d] = bits;
+		in->flags = (fl & ~(SR_C | SR_Z | SR_N | SR_V | SR_S | SR_H)) | (((m[0] == 'r') && (o & 1)) ? SR_C : 0);
+	} else if (!strcmp(m, "cpi") && !(fl & (SR_Z | SR_N | SR_V | SR_S | SR_H))) {
+		/* d < K only depends on the bits down to the lowest one set in K */
+		k = num(p, 1) & 0xff;
+		in->reg[d] |= ((fl & SR_C) && k) ? ~((k & -k) - 1) & 0xff : 0;
+		in->flags &= ~SR_C;
+	} else if (!strcmp(m, "swap")) {
+		in->reg[d] = ((o << 4) | (o >> 4)) & 0xff;
+	} else if (!strcmp(m, "bst")) {
+		in->reg[d] |= (fl & SR_T) ? 1 << num(p, 1) : 0;
+		in->flags &= ~SR_T;
+	} else if (!strcmp(m, "bld")) {
+		in->reg[d] = o & ~(1 << num(p, 1));
+		in->flags |= (o & (1 << num(p, 1))) ? SR_T : 0;
+	} else {
+		control = defUse(p, &def, &use);
+		for (i = 0; i < 32; i++) {
+			if ((def >> i) & 1) {
+				control |= (in->reg[i] != 0);
+				in->reg[i] = 0;
+			}
+		}
+		control |= (in->flags & (uint8_t)(def >> 32)) != 0;
+		in->flags &= ~(uint8_t)(def >> 32);
+		if (control) {
+			for (i = 0; i < 32; i++)
+				if ((use >> i) & 1)
+					in->reg[i] = 0xff;
+			in->flags |= (uint8_t)(use >> 32);
+		}
+	}
+}
+
+static void merge(live_t *to, const live_t *from)
+{
+	int	i;
+
+	for (i = 0; i < 32; i++)
+		to->reg[i] |= from->reg[i];
+	to->flags |= from->flags;
+}
+
+/*
+ * Backward data flow: what is live at each instruction. Register bits
+ * which never reach a branch are dropped from the states, otherwise data
+ * like the received byte would multiply them for nothing.
+ */
+static void liveness(void)
+{
+	live_t	out, in;
+	int	i, next, changed;
+
+	do {
+		changed = 0;
+		for (i = ninsn - 1; i >= 0; i--) {
+			next = follows(i);
+			memset(&out, 0, sizeof(out));
+			switch (insn[i].flow) {
+			case FLOW_SKIP:
+				if ((next >= 0) && (follows(next) >= 0))
+					merge(&out, &insn[follows(next)].live);
+				/* fall through */
+			case FLOW_NEXT:
+				if (next >= 0)
+					merge(&out, &insn[next].live);
+				break;
+			case FLOW_BRANCH:
+				if (next >= 0)
+					merge(&out, &insn[next].live);
+				/* fall through */
+			case FLOW_JUMP:
+				if (insn[i].target >= 0)
+					merge(&out, &insn[insn[i].target].live);
+				break;
+			}
+			transfer(&insn[i], &out, &in);
+			if (memcmp(&in, &insn[i].live, sizeof(in))) {
+				insn[i].live = in;
+				changed = 1;
+			}
+		}
+	} while (changed);
+}
+
+/* ------------------------------------------------------------------------- */
+
+/*
+ * A state without the range of deviations seen and the bits sent: a
+ * state with a wider range and fewer bits sent covers every path of
+ * one with the same key.
+ */
+static void keyOf(const state_t *s, state_t *key)
+{
+	int	d;
+
+	memcpy(key, s, offsetof(state_t, parent));
+	for (d = 0; d < 2; d++)
+		key->t[d].min = key->t[d].max = key->t[d].bits = 0;
+}
+
+static unsigned long hashState(const state_t *key)
+{
+	const unsigned char	*b = (const unsigned char *)key;
+	unsigned long		h = 5381;
+	size_t			i;
+
+	for (i = 0; i < offsetof(state_t, parent); i++)
+		h = h * 33 + b[i];
+	return h;
+}
+
+/* s can do nothing worse than states[i] */
+static int covered(const state_t *key, const state_t *s, long i)
+{
+	state_t	other;
+	int	d;
+
+	keyOf(&states[i], &other);
+	if (memcmp(key, &other, offsetof(state_t, parent)))
+		return 0;
+	for (d = 0; d < 2; d++)
+		if ((s->t[d].min < states[i].t[d].min) || (s->t[d].max > states[i].t[d].max) ||
+		    (s->t[d].bits < states[i].t[d].bits))
+			return 0;
+	return 1;
+}
+
+/* queues s unless a state covering it was seen before */
+static void pushState(state_t *s)
+{
+	const live_t	*live = &insn[s->pc].live;
+	state_t		key;
+	long		h, i;
+	int		r;
+
+	/* forget what does not matter any more so that equal states compare equal */
+	for (r = 0; r < 32; r++) {
+		s->kmask[r] &= live->reg[r];
+		s->reg[r] &= s->kmask[r];
+	}
+	s->sknown &= live->flags;
+	s->sreg &= s->sknown;
+	if ((s->zreg < 0) || !(live->flags & SR_Z) || (s->sknown & SR_Z) || !live->reg[s->zreg])
+		s->zreg = -1, s->zval = 0;
+	keyOf(s, &key);
+	h = hashState(&key) % hashSize;
+
+	while ((i = hashTable[h]) >= 0) {
+		if (covered(&key, s, i))
+			return;
+		h = (h + 1) % hashSize;
+	}
+	if (nstates == MAXSTATES) {
+		fprintf(stderr, "usbcycles: too many states\n");
+		exit(1);
+	}
+	states[nstates] = *s;
+	hashTable[h] = nstates;
+	stack[nstack++] = nstates++;
+}
+
+static void addEdge(int from, int to, unsigned cycles)
+{
+	int	i;
+
+	for (i = 0; i < nedges; i++)
+		if ((edges[i].from == from) && (edges[i].to == to) && (edges[i].cycles == cycles))
+			return;
+	if (nedges < MAXEDGES) {
+		edges[nedges].from = from;
+		edges[nedges].to = to;
+		edges[nedges++].cycles = cycles;
+	}
+}
+
+static void idle(timing_t *t)
+{
+	memset(t, 0, sizeof(*t));
+	t->last = t->pending = -1;
+}
+
+/*
+ * Fits an interval of the given length into the bit grid of direction d.
+ * The receiver must stay on the grid set by the start of the packet, the
+ * sampling points may spread over the window. The host resynchronizes on
+ * the edges we send and tolerates a bit rate off by MAXRATE: when sending
+ * the deviation may drift by that much per bit, beyond that it must stay
+ * within half the window.
+ */
+static void fit(timing_t *t, int d, unsigned cycles, long index)
+{
+	long	elapsed = t->dev + 1500L * cycles, bits = (elapsed + khz / 2) / khz, drift, spread;
+
+	t->dev = elapsed - bits * khz;
+	if (d == SYNC_RX) {
+		if (t->dev < t->min)
+			t->min = t->dev;
+		if (t->dev > t->max)
+			t->max = t->dev;
+		spread = t->max - t->min;
+	} else {
+		t->bits += bits;
+		drift = (long)(bits * khz * MAXRATE);
+		t->dev = (t->dev > drift) ? t->dev - drift : (t->dev < -drift) ? t->dev + drift : 0;
+		spread = 2 * labs(t->dev);
+	}
+	/* two sync points within one bit time are as bad as it gets */
+	if (!bits)
+		spread = 1500L * khz;
+	if (spread > worstSpread[d]) {
+		worstSpread[d] = spread;
+		worstState[d] = index;
+	}
+}
+
+/* the received sample pending in t is used: it is a sampling point of the packet */
+static void useSample(timing_t *t, long index)
+{
+	addEdge(t->last, t->sample, t->pending);
+	fit(t, SYNC_RX, t->pending, index);
+	t->last = t->sample;
+	t->cycles -= t->pending;
+	t->pending = -1;
+	t->sample = t->sampleReg = 0;
+}
+
+/*
+ * Sync point of direction d in the state with the given index. A
+ * received sample only counts once its register is read: when a packet
+ * ends, the handler may sample once more at a time which does not fit
+ * the grid and then leave without looking at the value. When sending,
+ * the last interval is the end of packet (SE0) which is not part of the
+ * bit grid, so each interval is only fitted when the next one starts and
+ * the bus is still driven.
+ */
+static void syncPoint(state_t *s, int d, long index)
+{
+	timing_t	*t = &s->t[d];
+
+	syncCount[d]++;
+	if (t->last < 0) {
+		idle(t);
+	} else if (d == SYNC_RX) {
+		if (t->pending >= 0)
+			useSample(t, index);
+		t->pending = t->cycles;
+		t->sample = s->pc;
+		t->sampleReg = reg(&insn[s->pc], 0);
+		return;
+	} else {
+		addEdge(t->last, s->pc, t->cycles);
+		if (t->pending >= 0)
+			fit(t, d, t->pending, index);
+		t->pending = t->cycles;
+		/* the length comes from RAM, stop following longer packets */
+		if (t->bits > MAXBITS) {
+			idle(t);
+			return;
+		}
+	}
+	t->last = s->pc;
+	t->cycles = 0;
+}
+
+/* writing USBDDR acquires or releases the bus */
+static void busDirection(state_t *s)
+{
+	timing_t	*t = &s->t[SYNC_TX];
+
+	if ((t->last >= 0) && (t->pending >= 0)) {
+		if ((unsigned)t->pending < eopMin)
+			eopMin = t->pending;
+		if ((unsigned)t->pending > eopMax)
+			eopMax = t->pending;
+	}
+	idle(t);
+}
+
+/* cycles since the last sync point, including one not used yet */
+static int32_t sinceSync(const timing_t *t, int d)
+{
+	return ((d == SYNC_RX) && (t->pending >= 0)) ? t->cycles - t->pending : t->cycles;
+}
+
+static void elapse(state_t *s, unsigned cycles)
+{
+	int	d;
+
+	for (d = 0; d < 2; d++) {
+		if (s->t[d].last < 0)
+			continue;
+		s->t[d].cycles += cycles;
+		if (sinceSync(&s->t[d], d) > 4 * khz / 1500)
+			idle(&s->t[d]);
+	}
+}
+
+/* p reads register r (or the pair starting with r - 1) */
+static int readsReg(const insn_t *p, int r)
+{
+	static const char	*writeOnly[] = {
+		"ldi", "ser", "clr", "mov", "movw", "in", "pop", "ld", "ldd", "lds", "lpm", "elpm", NULL
+	};
+	const char		*m = p->mnem;
+	int			i, x;
+
+	/* eor r, r and sub r, r clear r whatever it was */
+	if ((!strcmp(m, "eor") || !strcmp(m, "sub")) && (reg(p, 0) == reg(p, 1)))
+		return 0;
+	for (i = inList(m, writeOnly) ? 1 : 0; i < p->nops; i++) {
+		if ((x = reg(p, i)) < 0)
+			continue;
+		if (x == r)
+			return 1;
+		if ((x + 1 == r) && ((x >= 26) || !strcmp(m, "movw") || !strcmp(m, "adiw") || !strcmp(m, "sbiw")))
+			return 1;
+	}
+	return 0;
+}
+
+static void step(long index)
+{
+	state_t		s = states[index], n;
+	const insn_t	*p = &insn[s.pc];
+	timing_t	*rx = &s.t[SYNC_RX];
+	long		next = follows(s.pc), taken = -1;
+	int		cond = -1, z, zval;
+	unsigned	cycles = 0;
+	uint64_t	def, use;
+
+	if (p->unknown) {
+		fprintf(stderr, "usbcycles: line %d: unknown instruction \"%s\"\n", p->unknown, p->mnem);
+		exit(1);
+	}
+	defUse(p, &def, &use);
+	if ((rx->last >= 0) && (rx->pending >= 0)) {
+		if (readsReg(p, rx->sampleReg))
+			useSample(rx, index);
+		else if (def & LIVE_REG(rx->sampleReg))
+			rx->pending = -1, rx->sample = rx->sampleReg = 0;
+	}
+	if (isSync(p, SYNC_RX))
+		syncPoint(&s, SYNC_RX, index);
+	if (isSync(p, SYNC_TX))
+		syncPoint(&s, SYNC_TX, index);
+	if (!strcmp(p->mnem, "out") && (num(p, 0) == usbin + 1))
+		busDirection(&s);
+	cond = condition(&s, p);
+	z = s.zreg;
+	zval = s.zval;
+	s.zreg = -1;
+	execute(&s, p);
+	if (!(def & LIVE_FLAGS(SR_Z)) && (z >= 0) && !(def & LIVE_REG(z)))
+		s.zreg = z, s.zval = zval;
+	s.parent = index;
+
+	switch (p->flow) {
+	case FLOW_END:
+		return;
+	case FLOW_NEXT:
+		cond = 0;
+		break;
+	case FLOW_JUMP:
+		next = -1;
+		taken = p->target;
+		cycles = p->cycles;
+		break;
+	case FLOW_BRANCH:
+		taken = p->target;
+		cycles = 2;
+		break;
+	case FLOW_SKIP:
+		if (next >= 0) {
+			taken = follows(next);
+			cycles = 1 + insn[next].size / 2;
+		}
+		break;
+	}
+	if ((next >= 0) && (cond != 1)) {
+		n = s;
+		n.pc = next;
+		if (cond < 0)
+			refine(&n, p, 0);
+		elapse(&n, p->cycles);
+		pushState(&n);
+	}
+	if ((taken >= 0) && (cond != 0 || p->flow == FLOW_JUMP)) {
+		n = s;
+		n.pc = taken;
+		if (cond < 0)
+			refine(&n, p, 1);
+		elapse(&n, cycles);
+		pushState(&n);
+	}
+}
+
+static void printInsn(int i)
+{
+	printf("0x%04lx <%s+0x%lx>", insn[i].addr, insn[i].sym, insn[i].addr - insn[i].symaddr);
+}
+
+/* the sync points of the packet which ends with state i */
+static void printPacket(long i, int d)
+{
+	long	path[MAXPATH];
+	int	n = 0;
+
+	for (; (i >= 0) && (n < MAXPATH); i = states[i].parent) {
+		if (!isSync(&insn[states[i].pc], d))
+			continue;
+		path[n++] = i;
+		if (states[i].t[d].last < 0)
+			break;
+	}
+	while (n--) {
+		printf("    ");
+		printInsn(states[path[n]].pc);
+		printf(" after %d cycles\n", states[path[n]].t[d].last < 0 ? 0 : sinceSync(&states[path[n]].t[d], d));
+	}
+}
+
+/* ------------------------------------------------------------------------- */
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"usage: %s [-v] -k khz [-i addr] [-e symbol] [-w cycles] [file]\n"
+		"  reads \"avr-objdump -d usbdrvasm.o\" from file or stdin\n"
+		"  -k khz     USB_CFG_CLOCK_KHZ\n"
+		"  -i addr    I/O address of USBIN (PINx), default: the port read most often\n"
+		"  -e symbol  interrupt vector, default __vector_1 (INT0)\n"
+		"  -w cycles  spread of the sampling points allowed, default half a bit time\n"
+		"  -v         list the cycles between sync points\n",
+		prog);
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	const char	*entry = "__vector_1";
+	FILE		*f = stdin;
+	int		opt, i, d, verbose = 0, count[64] = { 0 }, rc = 0;
+	long		io;
+	double		w = -1;
+	state_t		s;
+
+	while ((opt = getopt(argc, argv, "vk:i:e:w:")) != -1) {
+		switch (opt) {
+		case 'v': verbose = 1;				break;
+		case 'k': khz = strtol(optarg, NULL, 0);	break;
+		case 'i': usbin = strtol(optarg, NULL, 0);	break;
+		case 'e': entry = optarg;			break;
+		case 'w': w = strtod(optarg, NULL);		break;
+		default:  usage(argv[0]);
+		}
+	}
+	if ((khz < 1000) || (argc - optind > 1))
+		usage(argv[0]);
+	if ((optind < argc) && !(f = fopen(argv[optind], "r"))) {
+		perror(argv[optind]);
+		return 1;
+	}
+	if (readDisassembly(f) < 0) {
+		fprintf(stderr, "usbcycles: no instructions found\n");
+		return 1;
+	}
+	window = (w < 0) ? (khz / 2) : (long)(w * 1500);
+	checkRx = (khz != 12800) && (khz != 16500);
+
+	for (i = 0; i < ninsn; i++)
+		if (!strcmp(insn[i].sym, entry) && (insn[i].addr == insn[i].symaddr))
+			break;
+	if (i == ninsn) {
+		fprintf(stderr, "usbcycles: symbol %s not found\n", entry);
+		return 1;
+	}
+	if (usbin < 0) {
+		for (d = 0, usbin = 0; d < ninsn; d++) {
+			if (!strcmp(insn[d].mnem, "in"))
+				io = num(&insn[d], 1);
+			else if (!strcmp(insn[d].mnem, "sbis") || !strcmp(insn[d].mnem, "sbic"))
+				io = num(&insn[d], 0);
+			else
+				continue;
+			if ((io >= 0) && (io < 64) && (++count[io] > count[usbin]))
+				usbin = io;
+		}
+	}
+
+	states = malloc(MAXSTATES * sizeof(*states));
+	stack = malloc(MAXSTATES * sizeof(*stack));
+	hashTable = malloc(hashSize * sizeof(*hashTable));
+	if (!states || !stack || !hashTable) {
+		fprintf(stderr, "usbcycles: out of memory\n");
+		return 1;
+	}
+	memset(hashTable, 0xff, hashSize * sizeof(*hashTable));
+	liveness();
+	memset(&s, 0, sizeof(s));
+	s.pc = i;
+	s.zreg = -1;
+	idle(&s.t[SYNC_RX]);
+	idle(&s.t[SYNC_TX]);
+	s.parent = -1;
+	pushState(&s);
+	while (nstack)
+		step(stack[--nstack]);
+
+	printf("%ld kHz, %.3f cycles per bit, USBIN 0x%02x, %ld states\n", khz, khz / 1500.0, usbin, nstates);
+	for (i = 0; verbose && (i < nedges); i++) {
+		printf("%s ", isSync(&insn[edges[i].from], SYNC_RX) ? "rx" : "tx");
+		printInsn(edges[i].from);
+		printf(" -> ");
+		printInsn(edges[i].to);
+		printf(": %u cycles, %.2f bits\n", edges[i].cycles, edges[i].cycles * 1500.0 / khz);
+	}
+	for (d = 0; d < 2; d++) {
+		if ((d == SYNC_RX) && !checkRx) {
+			printf("rx: not checked, this module resynchronizes on edges\n");
+			continue;
+		}
+		printf("%s: %lu sync points, ", (d == SYNC_RX) ? "rx" : "tx", syncCount[d]);
+		if (worstSpread[d] >= 1500L * khz)
+			printf("two within one bit time\n");
+		else
+			printf("spread %.2f cycles, limit %.2f\n", worstSpread[d] / 1500.0, window / 1500.0);
+		if (worstSpread[d] > window) {
+			printPacket(worstState[d], d);
+			rc = 1;
+		}
+	}
+	if (eopMax)
+		printf("eop: SE0 for %u to %u cycles (%.2f to %.2f us)\n", eopMin, eopMax, eopMin * 1000.0 / khz,
+		       eopMax * 1000.0 / khz);
+	printf("%s\n", rc ? "cycle budget violated" : "ok");
+	return rc;
+}